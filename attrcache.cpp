@@ -0,0 +1,182 @@
+#include "prefix.h"
+#include "attrcache.h"
+
+namespace
+{
+    QString typeString(hid_t type, hid_t space)
+    {
+        auto str = QString::fromStdString(HighFive::type_class_string(MyType(H5Tcopy(type)).getClass()));
+        int rank = H5Sget_simple_extent_ndims(space);
+        if(rank <= 0) return str;
+        std::vector<hsize_t> dims(rank);
+        H5Sget_simple_extent_dims(space, dims.data(), nullptr);
+        QStringList sl;
+        std::transform(dims.rbegin(), dims.rend(), std::back_inserter(sl), [](auto v){ return QString::number(v); });
+        return str + ": " + sl.join(L'×');
+    }
+
+    QString byteSize(hsize_t bytes)
+    {
+        if(bytes < 1024) return QObject::tr("%1 bytes").arg(bytes);
+        if(bytes < (1u << 20)) return QObject::tr("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+        return QObject::tr("%1 MB").arg(bytes / 1048576.0, 0, 'f', 1);
+    }
+
+    herr_t appendAttr(hid_t loc, const char* name, const H5A_info_t* info, void* data)
+    {
+        auto rows = (QVector<AttrRow>*)data;
+        AttrRow row;
+        row.name = QString::fromUtf8(name);
+        hid_t attr = H5Aopen(loc, name, H5P_DEFAULT);
+        if(attr < 0)
+        {
+            rows->append(row);
+            return 0;
+        }
+        hid_t type = H5Aget_type(attr);
+        hid_t space = H5Aget_space(attr);
+        if(type >= 0 && space >= 0) row.type = typeString(type, space);
+        // 变长的值读出来之前不知道有多大，元素多的也先不读
+        bool vlen = type >= 0 && (H5Tdetect_class(type, H5T_VLEN) > 0 || H5Tis_variable_str(type) > 0);
+        auto elements = space >= 0 ? H5Sget_simple_extent_npoints(space) : 0;
+        if(info->data_size > AttrCache::EAGER_BYTES || (vlen && (size_t)elements > AttrCache::MAX_ELEMENTS))
+        {
+            row.lazy = true;
+            row.value = "<" + byteSize(info->data_size) + ">";
+        }
+        else
+        {
+            row.value = AttrCache::formatValue(attr);
+        }
+        if(space >= 0) H5Sclose(space);
+        if(type >= 0) H5Tclose(type);
+        H5Aclose(attr);
+        rows->append(row);
+        return 0;
+    }
+}
+
+AttrCache::AttrCache(size_t capacity)
+: _capacity(std::max<size_t>(capacity, 1))
+{
+}
+
+std::string AttrCache::key(hid_t obj)
+{
+    H5O_info_t info;
+    if(H5Oget_info(obj, &info, H5O_INFO_BASIC) < 0) return {};
+    return objectKey(info);
+}
+
+QVector<AttrRow> AttrCache::list(hid_t obj)
+{
+    // 只遍历一次，每个属性只打开一次，小的值顺便读出来
+    QVector<AttrRow> rows;
+    hsize_t idx = 0;
+    H5Aiterate2(obj, H5_INDEX_NAME, H5_ITER_INC, &idx, &appendAttr, &rows);
+    return rows;
+}
+
+QString AttrCache::formatValue(hid_t attr)
+{
+    hid_t type = H5Aget_type(attr);
+    hid_t space = H5Aget_space(attr);
+    QString val;
+    if(type >= 0 && space >= 0)
+    {
+        auto size = H5Tget_size(type);
+        auto elements = (size_t)std::max<hssize_t>(H5Sget_simple_extent_npoints(space), 1);
+        std::vector<uint8_t> buff(size * elements, 0);
+        if(size > 0 && H5Aread(attr, type, buff.data()) >= 0)
+        {
+            auto shown = std::min(elements, MAX_ELEMENTS);
+            QStringList sl;
+            MyType data_type(H5Tcopy(type));
+            if(auto vlen = selectVlenFormat(data_type))
+            {
+                // VLEN的len是元素个数，按基类型格式化，和表格里一样
+                for(size_t i=0; i<shown; i++) sl.append(formatVlen(buff.data() + i * size, vlen));
+            }
+            else
+            {
+                // 数值类型只选一次格式化函数
+                auto kernel = selectKernel(data_type);
+                for(size_t i=0; i<shown; i++)
+                {
+                    auto p = buff.data() + i * size;
+                    sl.append(kernel ? formatCell(kernel, p) : getDisplayString(p, data_type));
+                }
+            }
+            // 变长的内容（包括compound成员里的）是HDF5分配的，一次全部释放
+            if(hasVlenData(type)) H5Treclaim(type, space, H5P_DEFAULT, buff.data());
+            val = sl.join(',');
+            if(shown < elements) val += QString(",… (%1)").arg(elements);
+            if(val.size() > MAX_CHARS) val = val.left(MAX_CHARS) + "…";
+        }
+    }
+    if(space >= 0) H5Sclose(space);
+    if(type >= 0) H5Tclose(type);
+    return val;
+}
+
+void AttrCache::insert(const std::string& key, Rows rows)
+{
+    auto itr = _index.find(key);
+    if(itr != _index.end())
+    {
+        _lru.erase(itr->second);
+        _index.erase(itr);
+    }
+    _lru.push_front({key, std::move(rows)});
+    _index[key] = _lru.begin();
+    while(_lru.size() > _capacity)
+    {
+        _index.erase(_lru.back().key);
+        _lru.pop_back();
+    }
+}
+
+AttrCache::Rows AttrCache::rows(hid_t obj)
+{
+    auto k = key(obj);
+    if(!k.empty())
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto itr = _index.find(k);
+        if(itr != _index.end())
+        {
+            _lru.splice(_lru.begin(), _lru, itr->second);
+            return itr->second->rows;
+        }
+    }
+
+    auto rows = std::make_shared<const QVector<AttrRow>>(list(obj));
+    if(!k.empty())
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        insert(k, rows);
+    }
+    return rows;
+}
+
+AttrCache::Rows AttrCache::readValue(hid_t obj, int row)
+{
+    auto current = rows(obj);
+    if(row < 0 || row >= current->size() || !(*current)[row].lazy) return current;
+
+    auto updated = std::make_shared<QVector<AttrRow>>(*current);
+    auto& attr_row = (*updated)[row];
+    hid_t attr = H5Aopen(obj, attr_row.name.toUtf8().constData(), H5P_DEFAULT);
+    if(attr < 0) return current;
+    attr_row.value = formatValue(attr);
+    attr_row.lazy = false;
+    H5Aclose(attr);
+
+    auto k = key(obj);
+    if(!k.empty())
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        insert(k, updated);
+    }
+    return updated;
+}
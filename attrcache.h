@@ -0,0 +1,44 @@
+#ifndef ATTRCACHE_H
+#define ATTRCACHE_H
+
+#include <mutex>
+#include <unordered_map>
+#include "helper.h"
+
+// 对象的属性表。一次H5Aiterate列出所有属性，小的值马上读出来，大的先只显示大小，双击时再读
+// 结果按对象地址缓存，在一个组里来回选择时不用再访问HDF5。每个文件一个，所有函数都要拿着HDF5的锁调用
+class AttrCache
+{
+public:
+    static constexpr size_t EAGER_BYTES = 4096; // 更大的值等到要看时再读
+    static constexpr size_t MAX_ELEMENTS = 32; // 只显示前几个元素
+    static constexpr int MAX_CHARS = 1024; // 显示的值截到这么长
+    static constexpr size_t DEFAULT_CAPACITY = 4096; // 缓存的对象个数
+
+    using Rows = std::shared_ptr<const QVector<AttrRow>>;
+
+    explicit AttrCache(size_t capacity = DEFAULT_CAPACITY);
+
+    Rows rows(hid_t obj);
+    // 读出第row个属性的值，更新缓存，返回新的属性表
+    Rows readValue(hid_t obj, int row);
+
+    static QString formatValue(hid_t attr); // 最多MAX_ELEMENTS个元素，截到MAX_CHARS
+
+private:
+    static std::string key(hid_t obj);
+    static QVector<AttrRow> list(hid_t obj);
+    void insert(const std::string& key, Rows rows); // 要先拿_mutex
+
+    struct Entry
+    {
+        std::string key;
+        Rows rows;
+    };
+    std::mutex _mutex;
+    std::list<Entry> _lru; // 最近使用的在前面
+    std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+    size_t _capacity;
+};
+
+#endif
@@ -0,0 +1,324 @@
+#include "prefix.h"
+#include "pager.h"
+#include "datatablemodel.h"
+#include "metaindex.h"
+#include "refresolver.h"
+#include "ioexecutor.h"
+#include "chunkcache.h"
+#include "hdf5lock.h"
+#include "helper.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <future>
+
+// 性能基准：在临时目录里生成测试文件（很深的组树、gzip压缩的chunk矩阵、MATLAB v7.3的cell引用数组、compound表、变长字符串表），
+// 分别测建索引、读页、格式化、解析引用、读取部分成员和翻看变长字符串的耗时，每项跑几次取最小值和中位数
+namespace
+{
+    struct Record
+    {
+        int64_t id;
+        double x;
+        double y;
+        char name[16];
+    };
+
+    struct Fixture
+    {
+        int depth;
+        int fanout;
+        size_t matrix; // 矩阵的边长
+        size_t cells; // cell数组的元素个数
+        size_t records;
+        size_t strings; // 变长字符串表的行数，每行4列
+    };
+
+    void createTree(HighFive::Group& group, int depth, int fanout)
+    {
+        if(depth == 0)
+        {
+            std::vector<double> values(16, 1.0);
+            group.createDataSet<double>("v", HighFive::DataSpace::From(values)).write(values);
+            return;
+        }
+        for(int i=0; i<fanout; i++)
+        {
+            auto child = group.createGroup("g" + std::to_string(i));
+            createTree(child, depth - 1, fanout);
+        }
+    }
+
+    void writeMatlabClass(hid_t obj, const char* cls)
+    {
+        // MATLAB写的是定长的ASCII字符串
+        hid_t type = H5Tcopy(H5T_C_S1);
+        H5Tset_size(type, strlen(cls));
+        hid_t space = H5Screate(H5S_SCALAR);
+        hid_t attr = H5Acreate2(obj, "MATLAB_class", type, space, H5P_DEFAULT, H5P_DEFAULT);
+        H5Awrite(attr, type, cls);
+        H5Aclose(attr);
+        H5Sclose(space);
+        H5Tclose(type);
+    }
+
+    hid_t chunkedPlist(const std::vector<hsize_t>& chunk, bool deflate)
+    {
+        hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(dcpl, (int)chunk.size(), chunk.data());
+        if(deflate)
+        {
+            H5Pset_shuffle(dcpl);
+            H5Pset_deflate(dcpl, 4);
+        }
+        return dcpl;
+    }
+
+    void createFixture(const QString& fileName, const Fixture& f)
+    {
+        H5Lock lock(hdf5Mutex());
+        HighFive::File file(fileName.toStdString(), HighFive::File::Truncate);
+
+        auto tree = file.createGroup("tree");
+        createTree(tree, f.depth, f.fanout);
+
+        // 平滑一点的数据，压缩率和真实的测量数据差不多
+        std::vector<double> matrix(f.matrix * f.matrix);
+        for(size_t i=0; i<matrix.size(); i++) matrix[i] = std::sin(i * 0.001) * 1000 + (double)(i % 7);
+        hsize_t mdims[2] = {f.matrix, f.matrix};
+        hid_t space = H5Screate_simple(2, mdims, nullptr);
+        hid_t dcpl = chunkedPlist({256, 256}, true);
+        hid_t ds = H5Dcreate2(file.getId(), "matrix", H5T_NATIVE_DOUBLE, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        H5Dwrite(ds, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, matrix.data());
+        writeMatlabClass(ds, "double");
+        H5Dclose(ds);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+
+        // MATLAB的cell数组：元素放在#refs#里，数组本身是对象引用
+        auto refs_group = file.createGroup("#refs#");
+        std::vector<hobj_ref_t> refs(f.cells);
+        for(size_t i=0; i<f.cells; i++)
+        {
+            auto name = "r" + std::to_string(i);
+            std::vector<double> values(i % 5 + 1, (double)i);
+            auto elem = refs_group.createDataSet<double>(name, HighFive::DataSpace::From(values));
+            elem.write(values);
+            writeMatlabClass(elem.getId(), "double");
+            H5Rcreate(&refs[i], file.getId(), ("/#refs#/" + name).c_str(), H5R_OBJECT, -1);
+        }
+        hsize_t cdims[2] = {1, f.cells};
+        space = H5Screate_simple(2, cdims, nullptr);
+        ds = H5Dcreate2(file.getId(), "cells", H5T_STD_REF_OBJ, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Dwrite(ds, H5T_STD_REF_OBJ, H5S_ALL, H5S_ALL, H5P_DEFAULT, refs.data());
+        writeMatlabClass(ds, "cell");
+        H5Dclose(ds);
+        H5Sclose(space);
+
+        // compound表，按chunk压缩
+        hid_t name_type = H5Tcopy(H5T_C_S1);
+        H5Tset_size(name_type, sizeof(Record::name));
+        hid_t rec_type = H5Tcreate(H5T_COMPOUND, sizeof(Record));
+        H5Tinsert(rec_type, "id", HOFFSET(Record, id), H5T_NATIVE_INT64);
+        H5Tinsert(rec_type, "x", HOFFSET(Record, x), H5T_NATIVE_DOUBLE);
+        H5Tinsert(rec_type, "y", HOFFSET(Record, y), H5T_NATIVE_DOUBLE);
+        H5Tinsert(rec_type, "name", HOFFSET(Record, name), name_type);
+        std::vector<Record> records(f.records);
+        for(size_t i=0; i<f.records; i++)
+        {
+            records[i] = Record{(int64_t)i, i * 0.5, i * 0.25, {}};
+            snprintf(records[i].name, sizeof(records[i].name), "rec%zu", i);
+        }
+        hsize_t rdims[1] = {f.records};
+        space = H5Screate_simple(1, rdims, nullptr);
+        dcpl = chunkedPlist({std::min<hsize_t>(f.records, 65536)}, true);
+        ds = H5Dcreate2(file.getId(), "table", rec_type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        H5Dwrite(ds, rec_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, records.data());
+        H5Dclose(ds);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+        H5Tclose(rec_type);
+        H5Tclose(name_type);
+
+        // 变长字符串表，长度不一
+        std::vector<std::string> texts(f.strings * 4);
+        std::vector<const char*> ptrs(texts.size());
+        for(size_t i=0; i<texts.size(); i++)
+        {
+            texts[i] = "row " + std::to_string(i / 4) + " " + std::string(i % 61, 'x');
+            ptrs[i] = texts[i].c_str();
+        }
+        hid_t str_type = H5Tcopy(H5T_C_S1);
+        H5Tset_size(str_type, H5T_VARIABLE);
+        hsize_t sdims[2] = {f.strings, 4};
+        space = H5Screate_simple(2, sdims, nullptr);
+        dcpl = chunkedPlist({std::min<hsize_t>(f.strings, 4096), 4}, true);
+        ds = H5Dcreate2(file.getId(), "strings", str_type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        H5Dwrite(ds, str_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, ptrs.data());
+        H5Dclose(ds);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+        H5Tclose(str_type);
+    }
+
+    class Bench
+    {
+    public:
+        Bench(QTextStream& out, int repeat)
+        :_out(out), _repeat(repeat)
+        {
+            _out << qSetFieldWidth(32) << left << "benchmark" << qSetFieldWidth(12) << right << "min ms" << "median ms" << qSetFieldWidth(0) << "\n";
+        }
+
+        // setup不计时，每次运行前调用
+        void run(const QString& name, const std::function<void()>& fn, const std::function<void()>& setup = nullptr)
+        {
+            std::vector<double> ms;
+            for(int i=0; i<_repeat; i++)
+            {
+                if(setup) setup();
+                QElapsedTimer timer;
+                timer.start();
+                fn();
+                ms.push_back(timer.nsecsElapsed() / 1e6);
+            }
+            std::sort(ms.begin(), ms.end());
+            _out << qSetFieldWidth(32) << left << name << qSetFieldWidth(12) << right
+                 << QString::number(ms.front(), 'f', 2) << QString::number(ms[ms.size() / 2], 'f', 2) << qSetFieldWidth(0) << "\n";
+            _out.flush();
+        }
+
+    private:
+        QTextStream& _out;
+        int _repeat;
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("HDF5PadBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generate synthetic HDF5/MAT v7.3 files and time the hot paths.");
+    parser.addHelpOption();
+    QCommandLineOption scaleOption("scale", "Fixture size multiplier, every fixture grows with it.", "n", "1");
+    QCommandLineOption repeatOption("repeat", "Runs per benchmark.", "n", "5");
+    QCommandLineOption keepOption("keep", "Keep the generated file in this directory.", "dir");
+    parser.addOptions({scaleOption, repeatOption, keepOption});
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    int scale = std::max(parser.value(scaleOption).toInt(), 1);
+    int repeat = std::max(parser.value(repeatOption).toInt(), 1);
+
+    QTemporaryDir temp;
+    auto dir = parser.isSet(keepOption) ? parser.value(keepOption) : temp.path();
+    auto fileName = QDir(dir).absoluteFilePath("bench.h5");
+    Fixture fixture{5 + scale, 4, 2048 * (size_t)scale, 20000 * (size_t)scale, 1000000 * (size_t)scale, 200000 * (size_t)scale};
+
+    try {
+        QElapsedTimer timer;
+        timer.start();
+        createFixture(fileName, fixture);
+        err << "fixture " << fileName << " created in " << timer.elapsed() << " ms\n";
+        err.flush();
+
+        HighFive::File file(fileName.toStdString(), HighFive::File::ReadOnly);
+        auto name = fileName.toStdString();
+        Bench bench(out, repeat);
+
+        // 打开文件、遍历组树（TreeLoader和搜索都靠它）
+        std::shared_ptr<const MetaIndex> index;
+        bench.run("tree/index build", [&]{ index = MetaIndex::build(file, fileName); });
+        bench.run("tree/index open", [&]{ index = MetaIndex::open(fileName); });
+
+        // 换页：每次都从压缩的chunk读，不用ChunkCache里上次解压的结果
+        // 只有主线程和导出文本的后台任务用HDF5，主线程等后台任务时不能拿着HDF5的锁
+        auto matrix = file.getDataSet("matrix");
+        auto dims = matrix.getDimensions();
+        auto size = matrix.getDataType().getSize();
+        auto dropChunks = [&]{ ChunkCache::instance().removeFile(name); };
+        std::shared_ptr<Pager> pager;
+        bench.run("page/open pager", [&]{ pager = std::make_shared<Pager>(matrix, dims, size); });
+        bench.run("page/chunked page", [&]{ pager->getPageData(0); }, [&]{
+            pager = std::make_shared<Pager>(matrix, dims, size);
+            dropChunks();
+        });
+        bench.run("page/cell tiles", [&]{
+            for(size_t r=0; r<dims[0]; r+=256) pager->getCell(0, r, r);
+        }, [&]{
+            pager = std::make_shared<Pager>(matrix, dims, size);
+            dropChunks();
+        });
+
+        // 表格的格式化：可见的一屏（同步）和整页输出成文本（复制、保存）
+        auto kernel = selectKernel(matrix.getDataType());
+        DataTableModel model(pager, 0, [kernel](const void* data, std::string*){ return formatCell(kernel, data); });
+        model.setKernel(kernel);
+        bench.run("format/visible cells", [&]{
+            for(int r=0; r<64; r++)
+                for(int c=0; c<16; c++) model.cellText(r, c);
+        });
+        auto writer = model.regionWriter({QRect(0, 0, (int)dims[1], (int)dims[0])}, ',');
+        IoExecutor executor;
+        bench.run("format/page to text", [&]{
+            // 和复制、保存一样在IoExecutor的后台线程里运行
+            std::promise<void> done;
+            executor.submit({}, [&](IoTask& task) -> IoTask::Result {
+                writer(task, [](std::string_view, size_t, size_t){ return true; });
+                done.set_value();
+                return {};
+            });
+            done.get_future().wait();
+        });
+
+        // MATLAB cell数组：解析引用的路径，再生成预览
+        auto cells = file.getDataSet("cells");
+        std::vector<hobj_ref_t> refs(cells.getElementCount());
+        cells.read(refs.data(), cells.getDataType());
+        std::shared_ptr<RefResolver> resolver;
+        auto newResolver = [&]{ resolver = std::make_shared<RefResolver>(file); };
+        bench.run("refs/resolve paths", [&]{ resolver->resolvePaths(refs); }, newResolver);
+        bench.run("refs/previews", [&]{
+            resolver->resolvePreviews(refs, [](const HighFive::DataSet& ds){ return datasetTypeStr(ds); });
+        }, [&]{
+            newResolver();
+            resolver->resolvePaths(refs);
+        });
+
+        // compound表：读取所有成员和只读一个成员
+        auto table = file.getDataSet("table");
+        auto tdims = table.getDimensions();
+        auto tsize = table.getDataType().getSize();
+        std::vector<uint8_t> buffer;
+        auto readTable = [&](std::vector<std::string> fields){
+            Pager p(table, tdims, tsize, {}, std::move(fields));
+            buffer.resize(p.columnCount() * p.dataSize());
+            p.readBlock(0, 0, 0, 1, p.columnCount(), buffer.data());
+        };
+        bench.run("compound/all fields", [&]{ readTable({}); }, dropChunks);
+        bench.run("compound/one field", [&]{ readTable({"x"}); }, dropChunks);
+
+        // 变长字符串表：从头翻到尾，每块读一次、格式化一格，挤出去的块整块释放
+        auto strings = file.getDataSet("strings");
+        auto sdims = strings.getDimensions();
+        auto vlen = selectVlenFormat(strings.getDataType());
+        bench.run("vlen/page through", [&]{
+            Pager p(strings, sdims, strings.getDataType().getSize());
+            for(size_t r=0; r<p.rowCount(); r+=256)
+            {
+                auto cell = p.getCell(0, r, 0);
+                if(cell) formatVlen(cell.get(), vlen);
+            }
+        });
+    }
+    catch(const HighFive::Exception& ex) {
+        err << "\n" << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include "prefix.h"
+#include "cellformatter.h"
+#include <charconv>
+#include <cstring>
+
+namespace
+{
+    // 和QString::number的默认格式一样('g', 6位有效数字)
+    constexpr int FLOAT_PRECISION = 6;
+
+    template<class T>
+    size_t toChars(T value, char* dst)
+    {
+        std::to_chars_result res;
+        if constexpr (std::is_floating_point_v<T>)
+            res = std::to_chars(dst, dst + CellKernel::MAX_CELL_CHARS, value, std::chars_format::general, FLOAT_PRECISION);
+        else
+            res = std::to_chars(dst, dst + CellKernel::MAX_CELL_CHARS, value);
+        return res.ec == std::errc() ? res.ptr - dst : 0;
+    }
+
+    template<class T, bool Swap>
+    size_t formatNumber(const void* src, char* dst)
+    {
+        return toChars(loadNumber<T, Swap>(src), dst);
+    }
+
+    template<bool Swap>
+    size_t formatHalf(const void* src, char* dst)
+    {
+        return toChars(halfToFloat(loadNumber<uint16_t, Swap>(src)), dst);
+    }
+
+    template<class T>
+    CellKernel numberKernel(bool swap)
+    {
+        return CellKernel{swap ? &formatNumber<T, true> : &formatNumber<T, false>, sizeof(T)};
+    }
+
+    CellKernel integerKernel(size_t size, bool is_signed, bool swap)
+    {
+        switch(size)
+        {
+        case 1: return is_signed ? numberKernel<int8_t>(swap) : numberKernel<uint8_t>(swap);
+        case 2: return is_signed ? numberKernel<int16_t>(swap) : numberKernel<uint16_t>(swap);
+        case 4: return is_signed ? numberKernel<int32_t>(swap) : numberKernel<uint32_t>(swap);
+        case 8: return is_signed ? numberKernel<int64_t>(swap) : numberKernel<uint64_t>(swap);
+        default: return {};
+        }
+    }
+
+    CellKernel floatKernel(size_t size, bool swap)
+    {
+        switch(size)
+        {
+        case 2: return CellKernel{swap ? &formatHalf<true> : &formatHalf<false>, 2};
+        case 4: return numberKernel<float>(swap);
+        case 8: return numberKernel<double>(swap);
+        default: return {};
+        }
+    }
+}
+
+float halfToFloat(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+    if(exp == 0x1f) // inf/nan
+    {
+        bits = sign | 0x7f800000 | (mant << 13);
+    }
+    else if(exp != 0)
+    {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    else if(mant == 0)
+    {
+        bits = sign;
+    }
+    else // 非规格化数
+    {
+        exp = 113;
+        while(!(mant & 0x400))
+        {
+            mant <<= 1;
+            exp--;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+bool isBigEndianHost()
+{
+    uint16_t v = 1;
+    uint8_t b;
+    memcpy(&b, &v, 1);
+    return b == 0;
+}
+
+CellKernel selectKernel(const HighFive::DataType& type)
+{
+    auto class_type = type.getClass();
+    if(class_type != HighFive::DataTypeClass::Integer && class_type != HighFive::DataTypeClass::Float) return {};
+
+    auto size = type.getSize();
+    auto order = H5Tget_order(type.getId());
+    bool swap = (order == H5T_ORDER_BE) != isBigEndianHost();
+    if(class_type == HighFive::DataTypeClass::Integer)
+    {
+        return integerKernel(size, H5Tget_sign(type.getId()) != H5T_SGN_NONE, swap);
+    }
+    return floatKernel(size, swap);
+}
+
+QString formatCell(const CellKernel& kernel, const void* src)
+{
+    char buf[CellKernel::MAX_CELL_CHARS];
+    auto len = kernel.format(src, buf);
+    return QString::fromLatin1(buf, (int)len);
+}
+
+void appendTextField(std::string& out, std::string_view field, char sep)
+{
+    const char special[] = {sep, '"', '\n', '\r'};
+    if(field.find_first_of(std::string_view(special, sizeof(special))) == std::string_view::npos)
+    {
+        out.append(field);
+        return;
+    }
+    out.push_back('"');
+    for(auto c : field)
+    {
+        if(c == '"') out.push_back('"');
+        out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+void TextArena::clear()
+{
+    _chars.clear();
+    _ends.clear();
+}
+
+size_t TextArena::size() const
+{
+    return _ends.size();
+}
+
+std::string_view TextArena::at(size_t idx) const
+{
+    size_t begin = idx == 0 ? 0 : _ends[idx - 1];
+    return std::string_view(_chars.data() + begin, _ends[idx] - begin);
+}
+
+const char* TextArena::data() const
+{
+    return _chars.data();
+}
+
+size_t TextArena::bytes() const
+{
+    return _ends.empty() ? 0 : _ends.back();
+}
+
+void TextArena::appendRow(const CellKernel& kernel, const void* src, size_t count)
+{
+    // 按最长的情况一次扩容，写完再截掉多余部分
+    size_t pos = bytes();
+    _chars.resize(pos + count * CellKernel::MAX_CELL_CHARS);
+    _ends.reserve(_ends.size() + count);
+    auto p = (const uint8_t*)src;
+    for(size_t i=0; i<count; i++, p += kernel.size)
+    {
+        pos += kernel.format(p, _chars.data() + pos);
+        _ends.push_back(pos);
+    }
+    _chars.resize(pos);
+}
+
+void TextArena::append(std::string_view text)
+{
+    _chars.insert(_chars.end(), text.begin(), text.end());
+    _ends.push_back(_chars.size());
+}
@@ -0,0 +1,67 @@
+#ifndef CELLFORMATTER_H
+#define CELLFORMATTER_H
+
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+
+// 数值按文件里的字节序存放，Swap表示和本机字节序相反
+template<class T>
+T swapBytes(T value)
+{
+    uint8_t bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    std::reverse(bytes, bytes + sizeof(T));
+    memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+template<class T, bool Swap>
+T loadNumber(const void* src)
+{
+    T value;
+    memcpy(&value, src, sizeof(T));
+    if constexpr (Swap) value = swapBytes(value);
+    return value;
+}
+
+float halfToFloat(uint16_t h); // IEEE半精度转单精度
+bool isBigEndianHost();
+
+// 数值单元格的格式化函数。每种(类型, 大小, 符号, 字节序)都有一个模板特化的函数，
+// 每页只按数据类型选一次，不用对每个单元格switch，也不经过QString::number
+struct CellKernel
+{
+    using FormatFn = size_t(*)(const void* src, char* dst); // dst至少要MAX_CELL_CHARS个字符，返回写入的长度
+    static constexpr size_t MAX_CELL_CHARS = 64;
+
+    FormatFn format{nullptr};
+    size_t size{0};
+
+    explicit operator bool() const { return format != nullptr; }
+};
+
+CellKernel selectKernel(const HighFive::DataType& type); // 不支持的类型返回空的CellKernel
+QString formatCell(const CellKernel& kernel, const void* src);
+// 文本表格的一个字段，里面有分隔符、引号或换行时按CSV的规则加引号
+void appendTextField(std::string& out, std::string_view field, char sep);
+
+// 一整行或一整块单元格格式化到同一块可以重复使用的缓冲区里，避免每个单元格一次分配
+class TextArena
+{
+public:
+    void clear();
+    size_t size() const;
+    std::string_view at(size_t idx) const;
+    const char* data() const;
+    size_t bytes() const;
+
+    void appendRow(const CellKernel& kernel, const void* src, size_t count); // src是连续的count个元素
+    void append(std::string_view text); // 不是数值的单元格，已经格式化好的文本
+
+private:
+    std::vector<char> _chars;
+    std::vector<size_t> _ends;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "prefix.h"
+#include "cellformatter.h"
+#include "helper.h"
+#include <QtTest>
+#include <cmath>
+#include <limits>
+
+// 数值单元格的格式化：按文件里的类型选函数，输出和QString::number的默认格式一样
+class CellFormatterTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static MyType halfType(H5T_order_t order)
+    {
+        MyType half(H5Tcopy(H5T_IEEE_F32LE));
+        H5Tset_fields(half.getId(), 15, 10, 5, 0, 10);
+        H5Tset_precision(half.getId(), 16);
+        H5Tset_ebias(half.getId(), 15);
+        H5Tset_size(half.getId(), 2);
+        H5Tset_order(half.getId(), order);
+        return half;
+    }
+
+    template<class T>
+    static QString format(const CellKernel& kernel, T value)
+    {
+        return formatCell(kernel, &value);
+    }
+
+private slots:
+    void unsignedValues()
+    {
+        // 同样的字节按有无符号显示不一样
+        auto u8 = selectKernel(HighFive::AtomicType<uint8_t>());
+        auto i8 = selectKernel(HighFive::AtomicType<int8_t>());
+        QCOMPARE(u8.size, (size_t)1);
+        QCOMPARE(format(u8, (uint8_t)200), QString("200"));
+        QCOMPARE(format(i8, (uint8_t)200), QString("-56"));
+
+        auto u64 = selectKernel(HighFive::AtomicType<uint64_t>());
+        QCOMPARE(format(u64, std::numeric_limits<uint64_t>::max()), QString("18446744073709551615"));
+        auto i64 = selectKernel(HighFive::AtomicType<int64_t>());
+        QCOMPARE(format(i64, std::numeric_limits<int64_t>::min()), QString("-9223372036854775808"));
+    }
+
+    void bigEndian()
+    {
+        MyType be(H5Tcopy(H5T_STD_U32BE));
+        auto kernel = selectKernel(be);
+        QVERIFY(kernel);
+        const uint8_t bytes[] = {0, 0, 1, 2};
+        QCOMPARE(formatCell(kernel, bytes), QString("258"));
+    }
+
+    void halfFloats()
+    {
+        QCOMPARE(halfToFloat(0x3c00), 1.0f);
+        QCOMPARE(halfToFloat(0xc000), -2.0f);
+        QCOMPARE(halfToFloat(0x7bff), 65504.0f);
+        QCOMPARE(halfToFloat(0x0001), 5.9604645e-08f); // 最小的非规格化数
+        QVERIFY(std::isinf(halfToFloat(0x7c00)));
+        QVERIFY(std::isnan(halfToFloat(0x7e00)));
+
+        auto kernel = selectKernel(halfType(isBigEndianHost() ? H5T_ORDER_BE : H5T_ORDER_LE));
+        QCOMPARE(kernel.size, (size_t)2);
+        QCOMPARE(format(kernel, (uint16_t)0x3555), QString("0.333252"));
+        QCOMPARE(format(kernel, (uint16_t)0x0001), QString("5.96046e-08"));
+        QCOMPARE(format(kernel, (uint16_t)0xfc00), QString("-inf"));
+
+        auto swapped = selectKernel(halfType(isBigEndianHost() ? H5T_ORDER_LE : H5T_ORDER_BE));
+        QCOMPARE(format(swapped, (uint16_t)0x003c), QString("1"));
+    }
+
+    void toCharsOutput()
+    {
+        // 6位有效数字，和QString::number(x)一样
+        auto f32 = selectKernel(HighFive::AtomicType<float>());
+        auto f64 = selectKernel(HighFive::AtomicType<double>());
+        QCOMPARE(format(f32, 0.1f), QString::number(0.1f));
+        QCOMPARE(format(f64, 123456789.0), QString("1.23457e+08"));
+        QCOMPARE(format(f64, 123456789.0), QString::number(123456789.0));
+        QCOMPARE(format(f64, 1e20), QString("1e+20"));
+        QCOMPARE(format(f64, -0.000125), QString("-0.000125"));
+        QCOMPARE(format(f64, 2.5), QString("2.5"));
+    }
+
+    void arenaRows()
+    {
+        auto kernel = selectKernel(HighFive::AtomicType<int32_t>());
+        const int32_t row[] = {7, -12, 300000};
+        TextArena arena;
+        arena.appendRow(kernel, row, 3);
+        arena.append("abc");
+        QCOMPARE(arena.size(), (size_t)4);
+        QCOMPARE(arena.at(1), std::string_view("-12"));
+        QCOMPARE(arena.at(3), std::string_view("abc"));
+        QCOMPARE(arena.bytes(), (size_t)13);
+        arena.clear();
+        QCOMPARE(arena.size(), (size_t)0);
+        QCOMPARE(arena.bytes(), (size_t)0);
+    }
+
+    void unsupportedType()
+    {
+        MyType str(H5Tcopy(H5T_C_S1));
+        QVERIFY(!selectKernel(str));
+    }
+};
+
+QTEST_GUILESS_MAIN(CellFormatterTest)
+#include "cellformatter_test.moc"
@@ -0,0 +1,86 @@
+#include "prefix.h"
+#include "chunkcache.h"
+
+ChunkCache& ChunkCache::instance()
+{
+    static ChunkCache cache;
+    return cache;
+}
+
+ChunkCache::Chunk ChunkCache::find(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto itr = _index.find(key);
+    if(itr == _index.end()) return nullptr;
+    _lru.splice(_lru.begin(), _lru, itr->second);
+    return itr->second->chunk;
+}
+
+void ChunkCache::insert(const std::string& key, Chunk chunk)
+{
+    if(!chunk || chunk->size() > budget()) return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto itr = _index.find(key);
+    if(itr != _index.end())
+    {
+        _bytes -= itr->second->chunk->size();
+        _lru.erase(itr->second);
+        _index.erase(itr);
+    }
+    _bytes += chunk->size();
+    _lru.push_front(Entry{key, std::move(chunk)});
+    _index[key] = _lru.begin();
+    evict();
+}
+
+void ChunkCache::setBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budget = bytes;
+    evict();
+}
+
+size_t ChunkCache::budget() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _budget;
+}
+
+void ChunkCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _lru.clear();
+    _index.clear();
+    _bytes = 0;
+}
+
+void ChunkCache::removeFile(const std::string& file_name)
+{
+    // 键是"文件名:数据集路径,chunk坐标"
+    auto prefix = file_name + ":";
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(auto itr = _lru.begin(); itr != _lru.end();)
+    {
+        if(itr->key.compare(0, prefix.size(), prefix) == 0)
+        {
+            _bytes -= itr->chunk->size();
+            _index.erase(itr->key);
+            itr = _lru.erase(itr);
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+}
+
+void ChunkCache::evict()
+{
+    while(_bytes > _budget && !_lru.empty())
+    {
+        auto& entry = _lru.back();
+        _bytes -= entry.chunk->size();
+        _index.erase(entry.key);
+        _lru.pop_back();
+    }
+}
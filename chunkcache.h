@@ -0,0 +1,40 @@
+#ifndef CHUNKCACHE_H
+#define CHUNKCACHE_H
+
+#include <mutex>
+#include <unordered_map>
+
+// 解压后的chunk缓存，所有数据集共用一个内存上限，最久没用的先丢掉。
+// 来回翻页或者滚动时，已经解压过的chunk直接从内存里取
+class ChunkCache
+{
+public:
+    using Chunk = std::shared_ptr<const std::vector<uint8_t>>;
+    static constexpr size_t DEFAULT_BUDGET = 256u << 20;
+
+    static ChunkCache& instance();
+
+    Chunk find(const std::string& key);
+    void insert(const std::string& key, Chunk chunk);
+    void setBudget(size_t bytes);
+    size_t budget() const;
+    void clear();
+    void removeFile(const std::string& file_name); // 丢掉这个文件的所有chunk
+
+private:
+    ChunkCache() = default;
+    void evict(); // 要先拿_mutex
+
+    struct Entry
+    {
+        std::string key;
+        Chunk chunk;
+    };
+    mutable std::mutex _mutex;
+    std::list<Entry> _lru; // 最近使用的在前面
+    std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+    size_t _bytes{0};
+    size_t _budget{DEFAULT_BUDGET};
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "prefix.h"
+#include "exporter.h"
+#include "helper.h"
+#include "chunkcache.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QTextStream>
+
+// 不开界面，把数据集或者整个组导出成csv/tsv/npy/raw，和界面共用路径解析和单元格格式化
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("HDF5PadCli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Export HDF5 datasets or groups without the GUI.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("file", "HDF5 file.");
+    parser.addPositionalArgument("path", "Dataset or group path in the file, / for the whole file.");
+    QCommandLineOption outputOption({"o", "output"}, "Output file for a dataset, output directory for a group.", "output");
+    QCommandLineOption formatOption({"f", "format"}, "csv, tsv, npy or raw. Default: from the output extension, otherwise csv.", "format");
+    QCommandLineOption blockOption("block-mb", "Size of one read block in MB.", "mb", QString::number(Exporter::DEFAULT_BLOCK_BYTES >> 20));
+    QCommandLineOption quietOption({"q", "quiet"}, "Do not report progress.");
+    parser.addOptions({outputOption, formatOption, blockOption, quietOption});
+    parser.process(app);
+
+    QTextStream err(stderr);
+    auto args = parser.positionalArguments();
+    if(args.size() != 2)
+    {
+        parser.showHelp(1);
+    }
+
+    auto output = parser.value(outputOption);
+    auto formatName = parser.isSet(formatOption) ? parser.value(formatOption) : QFileInfo(output).suffix();
+    auto format = Exporter::formatFromName(formatName);
+    if(!format)
+    {
+        if(parser.isSet(formatOption))
+        {
+            err << "Unknown format: " << formatName << "\n";
+            return 1;
+        }
+        format = Exporter::Format::Csv;
+    }
+    bool ok = false;
+    auto block_mb = parser.value(blockOption).toULongLong(&ok);
+    if(!ok || block_mb == 0)
+    {
+        err << "Invalid block size: " << parser.value(blockOption) << "\n";
+        return 1;
+    }
+
+    // 解压的chunk缓存也限制在一个块左右，总内存是块大小的几倍
+    ChunkCache::instance().setBudget(std::max<size_t>(block_mb << 20, 16u << 20));
+    Exporter exporter(*format, block_mb << 20);
+    if(!parser.isSet(quietOption))
+    {
+        int last = -1;
+        exporter.setProgress([&err, &last](size_t done, size_t total){
+            int percent = total ? (int)(done * 100 / total) : 100;
+            if(percent != last)
+            {
+                last = percent;
+                err << "\r" << percent << "%";
+                err.flush();
+            }
+            return true;
+        });
+    }
+
+    try {
+        HighFive::File file(args[0].toStdString(), HighFive::File::ReadOnly);
+        bool found = true;
+        auto exportGroup = [&](const HighFive::Group& group, const QString& name){
+            auto dir = output.isEmpty() ? name : output;
+            auto count = exporter.exportGroup(group, dir);
+            err << "\r" << count << " datasets exported to " << dir << "\n";
+        };
+        handlePath(file, args[1],
+            [&](const HighFive::File& f){
+                exportGroup(f.getGroup("/"), QFileInfo(args[0]).completeBaseName());
+            },
+            [&](const HighFive::DataSet& ds){
+                auto name = output.isEmpty() ? QString::fromStdString(ds.getPath()).section('/', -1) + "." + Exporter::extension(*format) : output;
+                exporter.exportDataSet(ds, name);
+                err << "\r" << QString::fromStdString(ds.getPath()) << " exported to " << name << "\n";
+            },
+            [&](const HighFive::Group& gp){
+                exportGroup(gp, QString::fromStdString(gp.getPath()).section('/', -1));
+            },
+            [&](){ found = false; }
+        );
+        if(!found)
+        {
+            err << "Not found: " << args[1] << "\n";
+            return 1;
+        }
+    }
+    catch(const std::exception& ex) {
+        err << "\n" << QString::fromLocal8Bit(ex.what()) << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "prefix.h"
+#include "datastats.h"
+#include "cellformatter.h"
+#include "hdf5lock.h"
+#include "pager.h"
+#include "parallel.h"
+#include <cmath>
+
+namespace
+{
+    constexpr size_t SPAN = 1024; // 一段先转成double放在栈上，两遍都在缓存里
+    constexpr size_t LANES = 8;
+    constexpr size_t PARALLEL_ELEMENTS = 1u << 16; // 线程池每个任务归约的元素个数
+
+    // 一段内两遍：先求和、最小最大值，再求和均值之差的平方和，比单遍的Welford公式容易向量化
+    DataStats reduceSpan(const double* v, size_t n)
+    {
+        DataStats res;
+        if(n == 0) return res;
+        double sum[LANES] = {};
+        double lo[LANES], hi[LANES];
+        std::fill(lo, lo + LANES, std::numeric_limits<double>::infinity());
+        std::fill(hi, hi + LANES, -std::numeric_limits<double>::infinity());
+        size_t i = 0;
+        for(; i + LANES <= n; i += LANES)
+        {
+            for(size_t j=0; j<LANES; j++)
+            {
+                auto x = v[i + j];
+                sum[j] += x;
+                lo[j] = x < lo[j] ? x : lo[j];
+                hi[j] = x > hi[j] ? x : hi[j];
+            }
+        }
+        for(size_t j=0; i + j < n; j++)
+        {
+            auto x = v[i + j];
+            sum[j] += x;
+            lo[j] = x < lo[j] ? x : lo[j];
+            hi[j] = x > hi[j] ? x : hi[j];
+        }
+        double total = 0;
+        for(size_t j=0; j<LANES; j++)
+        {
+            total += sum[j];
+            res.min = std::min(res.min, lo[j]);
+            res.max = std::max(res.max, hi[j]);
+        }
+        res.count = n;
+        res.mean = total / (double)n;
+
+        double dev[LANES] = {};
+        for(i=0; i + LANES <= n; i += LANES)
+        {
+            for(size_t j=0; j<LANES; j++)
+            {
+                auto d = v[i + j] - res.mean;
+                dev[j] += d * d;
+            }
+        }
+        for(size_t j=0; i + j < n; j++)
+        {
+            auto d = v[i + j] - res.mean;
+            dev[j] += d * d;
+        }
+        for(size_t j=0; j<LANES; j++) res.m2 += dev[j];
+        return res;
+    }
+
+    template<class T, bool Swap>
+    double toDouble(const uint8_t* p)
+    {
+        return (double)loadNumber<T, Swap>(p);
+    }
+
+    template<bool Swap>
+    double halfToDouble(const uint8_t* p)
+    {
+        return (double)halfToFloat(loadNumber<uint16_t, Swap>(p));
+    }
+
+    template<size_t Size, double(*Load)(const uint8_t*), bool MayBeNan>
+    DataStats reduceNumbers(const void* src, size_t count)
+    {
+        DataStats res;
+        double buf[SPAN];
+        auto p = (const uint8_t*)src;
+        for(size_t off=0; off<count; off+=SPAN)
+        {
+            auto n = std::min(SPAN, count - off);
+            for(size_t i=0; i<n; i++) buf[i] = Load(p + (off + i) * Size);
+            if constexpr (MayBeNan)
+            {
+                size_t nans = 0;
+                for(size_t i=0; i<n; i++) nans += buf[i] != buf[i];
+                if(nans > 0)
+                {
+                    // 很少见，去掉NaN再统计
+                    n = std::remove_if(buf, buf + n, [](double x){ return x != x; }) - buf;
+                    res.nan_count += nans;
+                }
+            }
+            res.merge(reduceSpan(buf, n));
+        }
+        return res;
+    }
+
+    template<size_t Size, double(*Load)(const uint8_t*)>
+    void convertNumbers(const void* src, double* dst, size_t count)
+    {
+        auto p = (const uint8_t*)src;
+        for(size_t i=0; i<count; i++) dst[i] = Load(p + i * Size);
+    }
+
+    template<size_t Size, double(*Load)(const uint8_t*), bool MayBeNan>
+    StatsKernel makeKernel()
+    {
+        return StatsKernel{&reduceNumbers<Size, Load, MayBeNan>, &convertNumbers<Size, Load>, Size};
+    }
+
+    template<class T>
+    StatsKernel numberKernel(bool swap)
+    {
+        constexpr bool nan = std::is_floating_point_v<T>;
+        return swap ? makeKernel<sizeof(T), &toDouble<T, true>, nan>() : makeKernel<sizeof(T), &toDouble<T, false>, nan>();
+    }
+
+    StatsKernel integerKernel(size_t size, bool is_signed, bool swap)
+    {
+        switch(size)
+        {
+        case 1: return is_signed ? numberKernel<int8_t>(swap) : numberKernel<uint8_t>(swap);
+        case 2: return is_signed ? numberKernel<int16_t>(swap) : numberKernel<uint16_t>(swap);
+        case 4: return is_signed ? numberKernel<int32_t>(swap) : numberKernel<uint32_t>(swap);
+        case 8: return is_signed ? numberKernel<int64_t>(swap) : numberKernel<uint64_t>(swap);
+        default: return {};
+        }
+    }
+
+    StatsKernel floatKernel(size_t size, bool swap)
+    {
+        switch(size)
+        {
+        case 2: return swap ? makeKernel<2, &halfToDouble<true>, true>() : makeKernel<2, &halfToDouble<false>, true>();
+        case 4: return numberKernel<float>(swap);
+        case 8: return numberKernel<double>(swap);
+        default: return {};
+        }
+    }
+}
+
+double DataStats::variance() const
+{
+    return count > 1 ? m2 / double(count - 1) : std::numeric_limits<double>::quiet_NaN();
+}
+
+double DataStats::stddev() const
+{
+    return std::sqrt(variance());
+}
+
+void DataStats::merge(const DataStats& other)
+{
+    nan_count += other.nan_count;
+    if(other.count == 0) return;
+    if(count == 0)
+    {
+        auto nans = nan_count;
+        *this = other;
+        nan_count = nans;
+        return;
+    }
+    auto n = double(count + other.count);
+    auto delta = other.mean - mean;
+    mean += delta * (double)other.count / n;
+    m2 += other.m2 + delta * delta * (double)count * (double)other.count / n;
+    count += other.count;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+StatsKernel selectStatsKernel(const HighFive::DataType& type)
+{
+    auto class_type = type.getClass();
+    if(class_type != HighFive::DataTypeClass::Integer && class_type != HighFive::DataTypeClass::Float) return {};
+
+    auto size = type.getSize();
+    bool swap = (H5Tget_order(type.getId()) == H5T_ORDER_BE) != isBigEndianHost();
+    if(class_type == HighFive::DataTypeClass::Integer)
+    {
+        return integerKernel(size, H5Tget_sign(type.getId()) != H5T_SGN_NONE, swap);
+    }
+    return floatKernel(size, swap);
+}
+
+std::optional<DataStats> computeStats(const HighFive::DataSet& dataset, const StatsProgress& progress, size_t block_bytes)
+{
+    std::unique_ptr<Pager> pager;
+    StatsKernel kernel;
+    {
+        H5Lock lock(hdf5Mutex());
+        auto type = dataset.getDataType();
+        kernel = selectStatsKernel(type);
+        if(!kernel) throw std::runtime_error(dataset.getPath() + ": statistics need a numeric data type");
+        pager = std::make_unique<Pager>(dataset, dataset.getDimensions(), kernel.size);
+    }
+    auto release = [&](){
+        H5Lock lock(hdf5Mutex());
+        pager.reset();
+    };
+
+    DataStats stats;
+    bool stopped = false;
+    try {
+        auto size = kernel.size;
+        auto total = pager->pageCount() * pager->rowCount() * pager->columnCount();
+        size_t done = 0;
+        stopped = !pager->forEachBlock(block_bytes, [&](const uint8_t* data, size_t, size_t, size_t, size_t rows, size_t cols){
+            auto count = rows * cols;
+            auto parts = (count + PARALLEL_ELEMENTS - 1) / PARALLEL_ELEMENTS;
+            std::vector<DataStats> partial(parts);
+            parallelFor(*QThreadPool::globalInstance(), parts, [&](size_t i){
+                auto first = i * PARALLEL_ELEMENTS;
+                partial[i] = kernel.reduce(data + first * size, std::min(PARALLEL_ELEMENTS, count - first));
+            });
+            for(auto& s : partial) stats.merge(s);
+
+            done += count;
+            return !progress || progress(stats, done, total);
+        });
+    }
+    catch(...) {
+        release();
+        throw;
+    }
+    release();
+    if(stopped) return std::nullopt;
+    return stats;
+}
@@ -0,0 +1,42 @@
+#ifndef DATASTATS_H
+#define DATASTATS_H
+
+#include <limits>
+
+// 数值数据的统计量。可以分块计算再按Chan的公式合并，合并的顺序不影响数值稳定性
+struct DataStats
+{
+    size_t count{0}; // 不含NaN
+    size_t nan_count{0};
+    double min{std::numeric_limits<double>::infinity()};
+    double max{-std::numeric_limits<double>::infinity()};
+    double mean{0};
+    double m2{0}; // 和均值之差的平方和
+
+    double variance() const; // 样本方差，少于两个数时是NaN
+    double stddev() const;
+    void merge(const DataStats& other);
+};
+
+// 每种(类型, 大小, 符号, 字节序)一个模板特化的归约函数，和CellKernel一样每个数据集只选一次
+// 内层循环按固定宽度分道累加，编译器可以自动向量化
+struct StatsKernel
+{
+    using ReduceFn = DataStats(*)(const void* src, size_t count);
+    using ConvertFn = void(*)(const void* src, double* dst, size_t count); // 转成double，预览图用
+
+    ReduceFn reduce{nullptr};
+    ConvertFn convert{nullptr};
+    size_t size{0};
+
+    explicit operator bool() const { return reduce != nullptr; }
+};
+
+StatsKernel selectStatsKernel(const HighFive::DataType& type); // 不支持的类型返回空的StatsKernel
+
+// 整个数据集按块流式读取（hyperslab），每块分给线程池并行归约后按顺序合并，内存用量和数据集大小无关
+// progress收到目前为止的结果和已处理的元素个数，返回false时停止并返回空；类型不支持时抛出异常。不要拿着HDF5的锁调用
+using StatsProgress = std::function<bool(const DataStats& partial, size_t done, size_t total)>;
+std::optional<DataStats> computeStats(const HighFive::DataSet& dataset, const StatsProgress& progress, size_t block_bytes = 16u << 20);
+
+#endif
@@ -0,0 +1,370 @@
+#include "prefix.h"
+#include "datatablemodel.h"
+#include "parallel.h"
+
+namespace
+{
+    constexpr int BLOCK_ROWS = 32;
+    constexpr int BLOCK_COLS = 16;
+    constexpr int BLOCK_CACHE_SIZE = 256;
+    constexpr size_t REGION_BLOCK_CELLS = 64 * 1024; // 复制、保存时每块的单元格数
+}
+
+DataTableModel::DataTableModel(std::shared_ptr<Pager> pager, size_t pageIdx, CellFormatter formatter, IoExecutor* executor, QObject *parent)
+: QAbstractTableModel(parent), _pager(std::move(pager)), _page_idx(pageIdx), _formatter(std::move(formatter)), _executor(executor), _blocks(BLOCK_CACHE_SIZE)
+{
+}
+
+DataTableModel::~DataTableModel()
+{
+    for(auto& task : _pending)
+    {
+        task->cancel();
+    }
+}
+
+size_t DataTableModel::page() const
+{
+    return _page_idx;
+}
+
+int DataTableModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid() || !_pager || _page_idx >= _pager->pageCount()) return 0;
+    if(isRecordView(*_pager, _members)) return (int)std::min<size_t>(_pager->columnCount(), INT_MAX);
+    return (int)std::min<size_t>(_pager->rowCount(), INT_MAX);
+}
+
+int DataTableModel::columnCount(const QModelIndex &parent) const
+{
+    if(parent.isValid() || !_pager || _page_idx >= _pager->pageCount()) return 0;
+    if(isRecordView(*_pager, _members)) return (int)_members->size();
+    size_t members = _members ? _members->size() : 1;
+    return (int)std::min<size_t>(_pager->columnCount() * members, INT_MAX);
+}
+
+QVariant DataTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(role != Qt::DisplayRole || orientation != Qt::Horizontal || !_members || !_pager)
+    {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    auto pos = locate(*_pager, _members, 0, section);
+    auto& name = (*_members)[pos.member].name;
+    if(isRecordView(*_pager, _members)) return name;
+    return QString("%1.%2").arg(pos.col + 1).arg(name);
+}
+
+bool DataTableModel::isRecordView(const Pager& pager, const Members& members)
+{
+    return members && pager.slice().rowAxis < 0;
+}
+
+DataTableModel::CellPos DataTableModel::locate(const Pager& pager, const Members& members, size_t row, size_t col)
+{
+    if(!members) return {row, col, -1};
+    if(isRecordView(pager, members)) return {0, row, (int)col};
+    auto n = members->size();
+    return {row, col / n, (int)(col % n)};
+}
+
+void DataTableModel::setMembers(std::vector<MemberColumn> members)
+{
+    beginResetModel();
+    _blocks.clear();
+    _members = members.empty() ? nullptr : std::make_shared<const std::vector<MemberColumn>>(std::move(members));
+    endResetModel();
+}
+
+quint64 DataTableModel::blockKey(int row, int col) const
+{
+    quint64 blockCols = (columnCount() + BLOCK_COLS - 1) / BLOCK_COLS;
+    return (quint64)(row / BLOCK_ROWS) * blockCols + col / BLOCK_COLS;
+}
+
+const DataTableModel::TextBlock* DataTableModel::cachedBlock(int row, int col, int& idx) const
+{
+    auto block = _blocks.object(blockKey(row, col));
+    if(block) idx = (row % BLOCK_ROWS) * block->cols + col % BLOCK_COLS;
+    return block;
+}
+
+void DataTableModel::setBlockPrepare(BlockPrepare prepare)
+{
+    _prepare = std::move(prepare);
+}
+
+void DataTableModel::setKernel(const CellKernel& kernel)
+{
+    _kernel = kernel;
+}
+
+DataTableModel::CellText DataTableModel::formatData(const CellFormatter& formatter, const void* data)
+{
+    CellText c;
+    if(!data) return c;
+    try {
+        // 格式化函数事先按类型选好，不调用HDF5，不用拿锁
+        std::string ref_path;
+        c.text = formatter(data, &ref_path);
+        c.ref_path = QString::fromStdString(ref_path);
+    }
+    catch(const HighFive::Exception&) {
+        c.text = "?";
+    }
+    return c;
+}
+
+DataTableModel::CellText DataTableModel::formatCell(Pager& pager, size_t pageIdx, const CellFormatter& formatter, const Members& members, int row, int col)
+{
+    try {
+        auto pos = locate(pager, members, row, col);
+        auto data = pager.getCell(pageIdx, pos.row, pos.col);
+        if(!data || pos.member < 0) return formatData(formatter, data.get());
+        auto& m = (*members)[pos.member];
+        return formatData(m.formatter, data.get() + m.offset);
+    }
+    catch(const HighFive::Exception&) {
+        return CellText{"?", {}};
+    }
+}
+
+void DataTableModel::applyBlock(quint64 key, int row0, int col0, int rows, TextBlock block, bool final)
+{
+    if(final) _pending.remove(key);
+    int cols = block.cols;
+    _blocks.insert(key, new TextBlock(std::move(block)));
+    emit dataChanged(index(row0, col0), index(row0 + rows - 1, col0 + cols - 1));
+}
+
+void DataTableModel::requestBlock(int row, int col) const
+{
+    auto key = blockKey(row, col);
+    if(_pending.contains(key)) return;
+
+    int row0 = row / BLOCK_ROWS * BLOCK_ROWS;
+    int col0 = col / BLOCK_COLS * BLOCK_COLS;
+    int rows = std::min(BLOCK_ROWS, rowCount() - row0);
+    int cols = std::min(BLOCK_COLS, columnCount() - col0);
+    auto self = const_cast<DataTableModel*>(this);
+    auto task = _executor->submit({}, [self, key, row0, col0, rows, cols, pager = _pager, page = _page_idx, formatter = _formatter, kernel = _kernel, members = _members, prepare = _prepare](IoTask& task) -> IoTask::Result {
+        // 先把整块的数据取出来，读取失败的单元格为空；成员列指向元素里的成员
+        std::vector<std::shared_ptr<const uint8_t>> cells(rows * cols);
+        std::vector<const void*> ptrs(rows * cols, nullptr);
+        std::vector<const CellFormatter*> formatters(rows * cols, &formatter);
+        for(int r=0; r<rows; r++)
+        {
+            if(task.isCancelled()) return {};
+            for(int c=0; c<cols; c++)
+            {
+                auto i = r * cols + c;
+                try {
+                    auto pos = locate(*pager, members, row0 + r, col0 + c);
+                    cells[i] = pager->getCell(page, pos.row, pos.col);
+                    ptrs[i] = cells[i].get();
+                    if(cells[i] && pos.member >= 0)
+                    {
+                        auto& m = (*members)[pos.member];
+                        ptrs[i] = cells[i].get() + m.offset;
+                        formatters[i] = &m.formatter;
+                    }
+                }
+                catch(const HighFive::Exception&) {
+                }
+            }
+        }
+
+        auto format = [&](){
+            auto block = std::make_shared<TextBlock>();
+            block->cols = cols;
+            for(size_t i=0; i<ptrs.size(); i++)
+            {
+                // 数值直接写进缓冲区，不经过QString
+                if(kernel && ptrs[i] && formatters[i] == &formatter)
+                {
+                    block->text.appendRow(kernel, ptrs[i], 1);
+                    continue;
+                }
+                auto c = formatData(*formatters[i], ptrs[i]);
+                auto bytes = c.text.toUtf8();
+                block->text.append(std::string_view(bytes.data(), bytes.size()));
+                if(!c.ref_path.isEmpty()) block->ref_paths.insert((int)i, c.ref_path);
+            }
+            return block;
+        };
+
+        bool needFull = prepare && prepare(ptrs, false, task);
+        auto block = format();
+        if(needFull && !task.isCancelled())
+        {
+            // 先显示快的结果，慢的部分准备好以后再刷新一次
+            task.post([self, key, row0, col0, rows, block](){
+                self->applyBlock(key, row0, col0, rows, *block, false);
+            });
+            prepare(ptrs, true, task);
+            if(task.isCancelled()) return {};
+            block = format();
+        }
+        // 在界面线程里执行，self已经由context检查过还活着
+        return [self, key, row0, col0, rows, block](){
+            self->applyBlock(key, row0, col0, rows, *block, true);
+        };
+    }, self);
+    _pending.insert(key, task);
+}
+
+QVariant DataTableModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid()) return {};
+    if(role != Qt::DisplayRole && role != Qt::UserRole) return {};
+
+    int idx;
+    if(!cachedBlock(index.row(), index.column(), idx) && _executor)
+    {
+        requestBlock(index.row(), index.column());
+        return {};
+    }
+    return role == Qt::DisplayRole ? cellText(index.row(), index.column()) : cellRefPath(index.row(), index.column());
+}
+
+QString DataTableModel::cellText(int row, int col) const
+{
+    int idx;
+    if(auto block = cachedBlock(row, col, idx))
+    {
+        auto text = block->text.at(idx);
+        return QString::fromUtf8(text.data(), (int)text.size());
+    }
+    return formatCell(*_pager, _page_idx, _formatter, _members, row, col).text;
+}
+
+QString DataTableModel::cellRefPath(int row, int col) const
+{
+    int idx;
+    if(auto block = cachedBlock(row, col, idx)) return block->ref_paths.value(idx);
+    return formatCell(*_pager, _page_idx, _formatter, _members, row, col).ref_path;
+}
+
+DataTableModel::RegionWriter DataTableModel::regionWriter(const QVector<QRect>& ranges, char sep) const
+{
+    QRect region;
+    for(auto& range : ranges) region |= range;
+    return [pager = _pager, page = _page_idx, formatter = _formatter, kernel = _kernel, members = _members, ranges, region, sep](IoTask& task, const TextSink& sink){
+        if(!pager || region.isEmpty()) return true;
+        // 不连续的选择只输出选中的单元格
+        bool masked = ranges.size() > 1;
+        auto selected = [&](size_t row, size_t c){
+            if(!masked) return true;
+            QPoint pt(region.left() + (int)c, region.top() + (int)row);
+            return std::any_of(ranges.begin(), ranges.end(), [&](const QRect& r){ return r.contains(pt); });
+        };
+        size_t cols = region.width();
+        size_t total = region.height();
+        size_t size = pager->dataSize();
+        size_t blockRows = std::max<size_t>(REGION_BLOCK_CELLS / cols, 1);
+        // 成员列要读的是页里的哪些元素：每个元素一行时是一行里连续的元素，否则是展开前的列
+        bool records = isRecordView(*pager, members);
+        size_t col0 = members && !records ? locate(*pager, members, 0, region.left()).col : region.left();
+        size_t readCols = members && !records ? locate(*pager, members, 0, region.right()).col - col0 + 1 : cols;
+        size_t threads = std::max(QThreadPool::globalInstance()->maxThreadCount(), 1);
+
+        struct Block
+        {
+            size_t row;
+            size_t rows;
+            std::vector<uint8_t> data;
+            std::string text;
+        };
+        std::vector<Block> blocks(threads);
+        // 变长数据是HDF5分配的，每轮格式化完一次释放，内存只和这几块有关
+        auto reclaim = [&](size_t n){
+            for(size_t i=0; i<n; i++) pager->reclaim(blocks[i].data.data(), blocks[i].data.size() / size);
+        };
+        for(size_t row=0; row<total; )
+        {
+            // 读取要拿HDF5的锁，按顺序读几块，再同时格式化
+            size_t n = 0;
+            try {
+                for(; n<threads && row<total; n++, row+=blockRows)
+                {
+                    auto& b = blocks[n];
+                    b.row = row;
+                    b.rows = std::min(blockRows, total - row);
+                    if(records)
+                    {
+                        b.data.resize(b.rows * size);
+                        pager->readBlock(page, 0, region.top() + row, 1, b.rows, b.data.data());
+                        continue;
+                    }
+                    b.data.resize(b.rows * readCols * size);
+                    pager->readBlock(page, region.top() + row, col0, b.rows, readCols, b.data.data());
+                }
+            }
+            catch(...) {
+                // 这一轮已经读出来的块也要释放
+                reclaim(n);
+                throw;
+            }
+            if(task.isCancelled())
+            {
+                reclaim(n);
+                return false;
+            }
+
+            parallelFor(*QThreadPool::globalInstance(), n, [&](size_t i){
+                auto& b = blocks[i];
+                b.text.clear();
+                TextArena arena;
+                auto p = b.data.data();
+                for(size_t r=0; r<b.rows; r++)
+                {
+                    if(members)
+                    {
+                        for(size_t c=0; c<cols; c++)
+                        {
+                            if(c > 0) b.text.push_back(sep);
+                            if(!selected(b.row + r, c)) continue;
+                            auto pos = locate(*pager, members, 0, region.left() + c);
+                            auto& m = (*members)[pos.member];
+                            auto element = records ? p : p + (pos.col - col0) * size;
+                            auto bytes = formatData(m.formatter, element + m.offset).text.toUtf8();
+                            appendTextField(b.text, std::string_view(bytes.data(), bytes.size()), sep);
+                        }
+                        p += (records ? 1 : readCols) * size;
+                    }
+                    else if(kernel)
+                    {
+                        arena.clear();
+                        arena.appendRow(kernel, p, cols);
+                        for(size_t c=0; c<cols; c++)
+                        {
+                            if(c > 0) b.text.push_back(sep);
+                            if(selected(b.row + r, c)) b.text.append(arena.at(c));
+                        }
+                        p += cols * size;
+                    }
+                    else
+                    {
+                        for(size_t c=0; c<cols; c++, p += size)
+                        {
+                            if(c > 0) b.text.push_back(sep);
+                            if(!selected(b.row + r, c)) continue;
+                            auto bytes = formatData(formatter, p).text.toUtf8();
+                            appendTextField(b.text, std::string_view(bytes.data(), bytes.size()), sep);
+                        }
+                    }
+                    b.text.push_back('\n');
+                }
+            });
+            reclaim(n);
+
+            for(size_t i=0; i<n; i++)
+            {
+                auto& b = blocks[i];
+                if(task.isCancelled() || !sink(b.text, b.row + b.rows, total)) return false;
+                task.setProgress(b.row + b.rows, total);
+            }
+        }
+        return true;
+    };
+}
@@ -0,0 +1,100 @@
+#ifndef DATATABLEMODEL_H
+#define DATATABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include "pager.h"
+#include "ioexecutor.h"
+#include "cellformatter.h"
+
+// 数据集某一页的虚拟表格，data()被调用时才从Pager取出单元格并格式化，不再为每个单元格创建QStandardItem
+// 有IoExecutor时，单元格按小块在后台读取和格式化，完成后通过dataChanged刷新
+class DataTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    // ref_path不为空时，引用类型的单元格把目标路径写到ref_path，双击时用来跳转
+    // 在后台线程里同时调用，不拿HDF5的锁：要用的类型信息事先拿着锁准备好
+    using CellFormatter = std::function<QString(const void* data, std::string* ref_path)>;
+
+    // 后台格式化一块单元格之前调用，用来批量准备格式化要用的东西（比如解析引用）
+    // full为false时只做快的部分，返回true表示还要再调用一次full为true的，中间先显示一次
+    using BlockPrepare = std::function<bool(const std::vector<const void*>& cells, bool full, IoTask& task)>;
+
+    // 复制或保存时一次交出的一段文本，已完成done行，一共total行；返回false时停止
+    using TextSink = std::function<bool(std::string_view text, size_t done, size_t total)>;
+    using RegionWriter = std::function<bool(IoTask& task, const TextSink& sink)>;
+
+    // compound的一个成员，offset是成员在Pager读出的元素里的位置，格式化时直接指向元素里的成员，不复制
+    struct MemberColumn
+    {
+        QString name;
+        size_t offset;
+        CellFormatter formatter;
+    };
+
+    DataTableModel(std::shared_ptr<Pager> pager, size_t pageIdx, CellFormatter formatter, IoExecutor* executor = nullptr, QObject *parent = nullptr);
+    ~DataTableModel();
+
+    void setBlockPrepare(BlockPrepare prepare);
+    void setKernel(const CellKernel& kernel); // 数值类型的格式化函数，批量输出时不经过CellFormatter
+    // 每个成员单独一列：页的每一列展开成members.size()列；没有行维度的页（1维数据集）每个元素一行，每个成员一列
+    void setMembers(std::vector<MemberColumn> members);
+    size_t page() const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // 同步读取，复制数据时用
+    QString cellText(int row, int col) const;
+    QString cellRefPath(int row, int col) const; // 不是引用时返回空字符串
+
+    // 在后台线程把选中的区域输出成文本（sep分隔，每行以换行结束）。输出ranges的外接矩形，不在任何range里的单元格留空。
+    // 按行块读取，各块在线程池里同时格式化，再按顺序交给sink，内存只和几块的大小有关。返回的函数不依赖DataTableModel
+    RegionWriter regionWriter(const QVector<QRect>& ranges, char sep) const;
+
+private:
+    struct CellText
+    {
+        QString text;
+        QString ref_path;
+    };
+    // 整块单元格的文本（UTF-8）放在一块缓冲区里，显示时才转成QString
+    struct TextBlock
+    {
+        int cols;
+        TextArena text;
+        QHash<int, QString> ref_paths; // 只有引用类型的单元格有
+    };
+    using Members = std::shared_ptr<const std::vector<MemberColumn>>;
+    // 表格的单元格在页里的位置，member为-1表示整个元素
+    struct CellPos
+    {
+        size_t row;
+        size_t col;
+        int member;
+    };
+    static bool isRecordView(const Pager& pager, const Members& members);
+    static CellPos locate(const Pager& pager, const Members& members, size_t row, size_t col);
+    quint64 blockKey(int row, int col) const;
+    const TextBlock* cachedBlock(int row, int col, int& idx) const; // idx是单元格在块里的位置
+    void requestBlock(int row, int col) const;
+    void applyBlock(quint64 key, int row0, int col0, int rows, TextBlock block, bool final);
+    static CellText formatCell(Pager& pager, size_t pageIdx, const CellFormatter& formatter, const Members& members, int row, int col);
+    static CellText formatData(const CellFormatter& formatter, const void* data);
+
+    std::shared_ptr<Pager> _pager;
+    size_t _page_idx;
+    CellFormatter _formatter;
+    BlockPrepare _prepare;
+    CellKernel _kernel;
+    Members _members;
+    IoExecutor* _executor;
+    mutable QCache<quint64, TextBlock> _blocks; // 只缓存显示过的块
+    mutable QHash<quint64, std::shared_ptr<IoTask>> _pending;
+};
+
+#endif
@@ -0,0 +1,297 @@
+#include "prefix.h"
+#include "exporter.h"
+#include "pager.h"
+#include "helper.h"
+#include "hdf5lock.h"
+#include <QDir>
+
+namespace
+{
+    bool isNumeric(HighFive::DataTypeClass class_type)
+    {
+        return class_type == HighFive::DataTypeClass::Integer || class_type == HighFive::DataTypeClass::Float;
+    }
+
+    // npy的dtype描述，比如'<f8'、'|u1'、'|S10'
+    std::string npyDescr(const HighFive::DataType& type)
+    {
+        auto size = type.getSize();
+        auto class_type = type.getClass();
+        if(class_type == HighFive::DataTypeClass::String)
+        {
+            return "|S" + std::to_string(size);
+        }
+        char order = size == 1 ? '|' : (H5Tget_order(type.getId()) == H5T_ORDER_BE ? '>' : '<');
+        char kind = 'f';
+        if(class_type == HighFive::DataTypeClass::Integer)
+        {
+            kind = H5Tget_sign(type.getId()) == H5T_SGN_NONE ? 'u' : 'i';
+        }
+        return order + (kind + std::to_string(size));
+    }
+}
+
+std::optional<Exporter::Format> Exporter::formatFromName(const QString& name)
+{
+    auto n = name.toLower();
+    if(n == "csv") return Format::Csv;
+    if(n == "tsv") return Format::Tsv;
+    if(n == "npy") return Format::Npy;
+    if(n == "raw" || n == "bin") return Format::Raw;
+    return std::nullopt;
+}
+
+QString Exporter::extension(Format format)
+{
+    switch(format)
+    {
+    case Format::Csv: return "csv";
+    case Format::Tsv: return "tsv";
+    case Format::Npy: return "npy";
+    default: return "bin";
+    }
+}
+
+bool Exporter::supports(Format format, const HighFive::DataType& type)
+{
+    H5Lock lock(hdf5Mutex());
+    auto class_type = type.getClass();
+    if(H5Tdetect_class(type.getId(), H5T_VLEN) > 0 && H5Tis_variable_str(type.getId()) <= 0) return false;
+    switch(format)
+    {
+    case Format::Npy:
+        return isNumeric(class_type) || (class_type == HighFive::DataTypeClass::String && H5Tis_variable_str(type.getId()) <= 0);
+    case Format::Raw:
+        return !hasVlenData(type.getId());
+    default:
+        return true;
+    }
+}
+
+Exporter::Exporter(Format format, size_t block_bytes)
+: _format(format), _block_bytes(std::max<size_t>(block_bytes, 1))
+{
+}
+
+void Exporter::setProgress(Progress progress)
+{
+    _progress = std::move(progress);
+}
+
+bool Exporter::stopped() const
+{
+    return _stopped;
+}
+
+void Exporter::write(QFile& file, const char* data, size_t size)
+{
+    if(size > 0 && file.write(data, (qint64)size) != (qint64)size)
+    {
+        throw std::runtime_error("Unable to write " + file.fileName().toStdString());
+    }
+}
+
+void Exporter::writeNpyHeader(QFile& file, const HighFive::DataType& type, const std::vector<size_t>& dims) const
+{
+    std::string shape;
+    for(auto d : dims) shape += std::to_string(d) + ", ";
+    if(dims.size() > 1) shape.erase(shape.size() - 2);
+    else if(!dims.empty()) shape.pop_back();
+    std::string header = "{'descr': '" + npyDescr(type) + "', 'fortran_order': False, 'shape': (" + shape + "), }";
+
+    // 魔数、版本、长度之后的头按64字节对齐，最后是换行
+    const size_t prefix = 10;
+    header.append(63 - (prefix + header.size()) % 64, ' ');
+    header.push_back('\n');
+    if(header.size() > UINT16_MAX) throw std::runtime_error("npy header too long");
+    uint16_t len = (uint16_t)header.size();
+    char magic[prefix] = {'\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0, (char)(len & 0xff), (char)(len >> 8)};
+    write(file, magic, prefix);
+    write(file, header.data(), header.size());
+}
+
+void Exporter::appendText(const HighFive::DataType& type, const std::vector<HighFive::CompoundType::member_def>& members, const uint8_t* data)
+{
+    // 和界面上显示的一样，数值用CellKernel，其它类型用getDisplayString
+    auto class_type = type.getClass();
+    char sep = _format == Format::Tsv ? '\t' : ',';
+    if(H5Tis_variable_str(type.getId()) > 0)
+    {
+        // 直接写HDF5分配的字符串，不经过QString
+        appendTextField(_line, vlenView(data, VlenFormat{true}), sep);
+        return;
+    }
+    QString str;
+    if(class_type == HighFive::DataTypeClass::String)
+    {
+        auto p = (const char*)data;
+        str = QString::fromLocal8Bit(p, (int)strnlen(p, type.getSize()));
+    }
+    else if(class_type == HighFive::DataTypeClass::Compound)
+    {
+        QStringList sl;
+        for(auto& m : members)
+        {
+            sl.append(getDisplayString(data + m.offset, m.base_type));
+        }
+        str = "{"+sl.join(',')+"}";
+    }
+    else
+    {
+        str = getDisplayString(data, type);
+    }
+    auto bytes = str.toUtf8();
+    appendTextField(_line, std::string_view(bytes.data(), bytes.size()), sep);
+}
+
+void Exporter::writeCells(QFile& file, const HighFive::DataType& type, const uint8_t* data, size_t count, size_t col0, size_t cols)
+{
+    // data是连续的count个元素，第一个在行里的位置是col0，每行cols个
+    char sep = _format == Format::Tsv ? '\t' : ',';
+    size_t size;
+    CellKernel kernel;
+    {
+        H5Lock lock(hdf5Mutex());
+        size = type.getSize();
+        kernel = selectKernel(type);
+    }
+    _line.clear();
+    size_t i = 0;
+    while(i < count)
+    {
+        auto col = (col0 + i) % cols;
+        auto n = std::min(count - i, cols - col);
+        if(kernel)
+        {
+            _arena.clear();
+            _arena.appendRow(kernel, data + i * size, n);
+            for(size_t k=0; k<n; k++)
+            {
+                if(col + k > 0) _line.push_back(sep);
+                _line.append(_arena.at(k));
+            }
+        }
+        else
+        {
+            // 非数值类型要调用HDF5
+            H5Lock lock(hdf5Mutex());
+            std::vector<HighFive::CompoundType::member_def> members;
+            if(type.getClass() == HighFive::DataTypeClass::Compound) members = HighFive::CompoundType(type).getMembers();
+            for(size_t k=0; k<n; k++)
+            {
+                if(col + k > 0) _line.push_back(sep);
+                appendText(type, members, data + (i + k) * size);
+            }
+        }
+        if(col + n == cols) _line.push_back('\n');
+        i += n;
+    }
+    write(file, _line.data(), _line.size());
+}
+
+bool Exporter::exportDataSet(const HighFive::DataSet& dataset, const QString& fileName)
+{
+    _stopped = false;
+    std::unique_ptr<Pager> pager;
+    std::optional<HighFive::DataType> type;
+    std::vector<size_t> dims;
+    size_t size;
+    {
+        H5Lock lock(hdf5Mutex());
+        type = dataset.getDataType();
+        dims = dataset.getDimensions();
+        size = type->getSize();
+        if(!supports(_format, *type))
+        {
+            throw std::runtime_error(dataset.getPath() + ": data type not supported by " + extension(_format).toStdString());
+        }
+        pager = std::make_unique<Pager>(dataset, dims, size);
+    }
+    auto release = [&](){
+        H5Lock lock(hdf5Mutex());
+        pager.reset();
+        type.reset();
+    };
+
+    try {
+        QFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            throw std::runtime_error("Unable to create " + fileName.toStdString());
+        }
+        if(_format == Format::Npy) writeNpyHeader(file, *type, dims);
+
+        bool text = _format == Format::Csv || _format == Format::Tsv;
+        auto line_cols = dims.size() > 1 ? pager->columnCount() : 1; // 1维数据集每行一个值
+        auto total = pager->pageCount() * pager->rowCount() * pager->columnCount();
+        size_t done = 0;
+
+        // 变长字符串是HDF5分配的，forEachBlock每块写完就一次释放
+        _stopped = !pager->forEachBlock(_block_bytes, [&](const uint8_t* data, size_t, size_t, size_t col, size_t rows, size_t cols){
+            auto count = rows * cols;
+            if(text)
+            {
+                writeCells(file, *type, data, count, line_cols == 1 ? 0 : col, line_cols);
+            }
+            else
+            {
+                write(file, (const char*)data, count * size);
+            }
+            done += count;
+            return !_progress || _progress(done, total);
+        });
+    }
+    catch(...) {
+        release();
+        throw;
+    }
+    release();
+    return !_stopped;
+}
+
+size_t Exporter::exportGroup(const HighFive::Group& group, const QString& dirName)
+{
+    if(!QDir().mkpath(dirName))
+    {
+        throw std::runtime_error("Unable to create " + dirName.toStdString());
+    }
+    std::vector<std::string> names;
+    {
+        H5Lock lock(hdf5Mutex());
+        names = group.listObjectNames();
+    }
+
+    size_t exported = 0;
+    for(auto& name : names)
+    {
+        auto path = dirName + "/" + QString::fromStdString(name);
+        std::optional<HighFive::DataSet> dataset;
+        std::optional<HighFive::Group> sub;
+        {
+            H5Lock lock(hdf5Mutex());
+            auto type = group.getObjectType(name);
+            if(type == HighFive::ObjectType::Dataset)
+            {
+                dataset = group.getDataSet(name);
+                if(!supports(_format, dataset->getDataType())) dataset.reset();
+            }
+            else if(type == HighFive::ObjectType::Group)
+            {
+                sub = group.getGroup(name);
+            }
+        }
+        if(sub)
+        {
+            exported += exportGroup(*sub, path);
+        }
+        else if(dataset && exportDataSet(*dataset, path + "." + extension(_format)))
+        {
+            exported++;
+        }
+        H5Lock lock(hdf5Mutex());
+        dataset.reset();
+        sub.reset();
+        if(_stopped) break;
+    }
+    return exported;
+}
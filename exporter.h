@@ -0,0 +1,44 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QFile>
+#include "cellformatter.h"
+
+// 把数据集按固定大小的块流式写到文件，每次只读一块（hyperslab），内存用量和数据集大小无关
+// 文本格式每行是表格的一行（1维数据集每行一个值），高维度的页依次接在后面；npy和raw保持文件里的字节序
+class Exporter
+{
+public:
+    enum class Format { Csv, Tsv, Npy, Raw };
+    static constexpr size_t DEFAULT_BLOCK_BYTES = 64u << 20;
+
+    using Progress = std::function<bool(size_t done, size_t total)>; // 按元素个数，返回false时停止导出
+
+    static std::optional<Format> formatFromName(const QString& name); // csv、tsv、npy、raw或bin
+    static QString extension(Format format);
+    static bool supports(Format format, const HighFive::DataType& type);
+
+    explicit Exporter(Format format, size_t block_bytes = DEFAULT_BLOCK_BYTES);
+    void setProgress(Progress progress);
+
+    // 出错时抛出异常，返回false表示被Progress停止了
+    bool exportDataSet(const HighFive::DataSet& dataset, const QString& fileName);
+    // 组下面的数据集按同样的层次写到目录里，格式不支持的数据集跳过，返回导出的个数；被Progress停止时stopped()为true
+    size_t exportGroup(const HighFive::Group& group, const QString& dirName);
+    bool stopped() const;
+
+private:
+    void writeNpyHeader(QFile& file, const HighFive::DataType& type, const std::vector<size_t>& dims) const;
+    void writeCells(QFile& file, const HighFive::DataType& type, const uint8_t* data, size_t count, size_t col0, size_t cols);
+    void appendText(const HighFive::DataType& type, const std::vector<HighFive::CompoundType::member_def>& members, const uint8_t* data);
+    static void write(QFile& file, const char* data, size_t size);
+
+    Format _format;
+    size_t _block_bytes;
+    Progress _progress;
+    TextArena _arena;
+    std::string _line; // 文本格式一块的输出
+    bool _stopped{false};
+};
+
+#endif
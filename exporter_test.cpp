@@ -0,0 +1,156 @@
+#include "prefix.h"
+#include "exporter.h"
+#include "helper.h"
+#include <QTemporaryDir>
+#include <QtTest>
+
+// npy的头按64字节对齐，文本格式每行是表格的一行，块的大小不影响输出
+class ExporterTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir _dir;
+    std::optional<HighFive::File> _file;
+
+    QByteArray exportAs(Exporter::Format format, const std::string& name, size_t block_bytes = Exporter::DEFAULT_BLOCK_BYTES)
+    {
+        auto path = _dir.filePath(QString::fromStdString(name) + "." + Exporter::extension(format));
+        Exporter exporter(format, block_bytes);
+        if(!exporter.exportDataSet(_file->getDataSet(name), path)) return {};
+        QFile file(path);
+        if(!file.open(QIODevice::ReadOnly)) return {};
+        return file.readAll();
+    }
+
+    // 魔数、版本和头的长度之后是头，返回头的内容
+    static QByteArray npyHeader(const QByteArray& bytes)
+    {
+        if(bytes.size() < 10 || !bytes.startsWith(QByteArray("\x93NUMPY\x01\x00", 8))) return {};
+        auto len = (uint8_t)bytes[8] | (uint8_t)bytes[9] << 8;
+        return bytes.mid(10, len);
+    }
+
+    void writeData(const char* name, hid_t type, const void* data, hsize_t n)
+    {
+        hid_t space = H5Screate_simple(1, &n, nullptr);
+        hid_t ds = H5Dcreate2(_file->getId(), name, type, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Dwrite(ds, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+        H5Dclose(ds);
+        H5Sclose(space);
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(_dir.isValid());
+        _file.emplace(_dir.filePath("data.h5").toStdString(), HighFive::File::Truncate);
+
+        std::vector<int> line{1, 2, 3};
+        _file->createDataSet<int>("line", HighFive::DataSpace::From(line)).write(line);
+        std::vector<std::vector<double>> matrix{{0.5, 1, 2}, {10, 11, 12.25}};
+        _file->createDataSet<double>("matrix", HighFive::DataSpace::From(matrix)).write(matrix);
+        std::vector<std::vector<std::vector<int>>> cube{{{0, 1}, {2, 3}}, {{4, 5}, {6, 7}}};
+        _file->createDataSet<int>("cube", HighFive::DataSpace::From(cube)).write(cube);
+        std::vector<uint8_t> bytes{7, 200};
+        _file->createDataSet<uint8_t>("bytes", HighFive::DataSpace::From(bytes)).write(bytes);
+
+        struct Record
+        {
+            int id;
+            double value;
+        };
+        Record records[] = {{1, 0.5}, {2, 1.5}};
+        MyType record(H5Tcreate(H5T_COMPOUND, sizeof(Record)));
+        H5Tinsert(record.getId(), "id", HOFFSET(Record, id), H5T_NATIVE_INT);
+        H5Tinsert(record.getId(), "value", HOFFSET(Record, value), H5T_NATIVE_DOUBLE);
+        writeData("records", record.getId(), records, 2);
+
+        MyType fixed(H5Tcopy(H5T_C_S1));
+        H5Tset_size(fixed.getId(), 4);
+        const char names[] = "ab\0\0c,d\0x\"y\0";
+        writeData("names", fixed.getId(), names, 3);
+
+        MyType str(H5Tcopy(H5T_C_S1));
+        H5Tset_size(str.getId(), H5T_VARIABLE);
+        const char* texts[] = {"hi", "a\tb"};
+        writeData("texts", str.getId(), texts, 2);
+    }
+
+    void cleanupTestCase()
+    {
+        _file.reset();
+    }
+
+    void npyHeaderAligned()
+    {
+        auto bytes = exportAs(Exporter::Format::Npy, "matrix");
+        auto header = npyHeader(bytes);
+        QVERIFY(!header.isEmpty());
+        QCOMPARE((10 + header.size()) % 64, 0);
+        QVERIFY(header.endsWith('\n'));
+        QByteArray descr = isBigEndianHost() ? "'descr': '>f8'" : "'descr': '<f8'";
+        QVERIFY(header.contains(descr));
+        QVERIFY(header.contains("'fortran_order': False"));
+        QVERIFY(header.contains("'shape': (2, 3)"));
+
+        // 头后面是按行存放的数据
+        std::vector<double> data(6);
+        QCOMPARE((size_t)bytes.size(), 10 + header.size() + data.size() * sizeof(double));
+        memcpy(data.data(), bytes.constData() + 10 + header.size(), data.size() * sizeof(double));
+        QCOMPARE(data, (std::vector<double>{0.5, 1, 2, 10, 11, 12.25}));
+    }
+
+    void npyDescrAndShape()
+    {
+        auto bytes = npyHeader(exportAs(Exporter::Format::Npy, "bytes"));
+        QVERIFY(bytes.contains("'descr': '|u1'"));
+        QVERIFY(bytes.contains("'shape': (2,)")); // 1维的元组要有逗号
+        auto names = npyHeader(exportAs(Exporter::Format::Npy, "names"));
+        QVERIFY(names.contains("'descr': '|S4'"));
+        QVERIFY(names.contains("'shape': (3,)"));
+        auto cube = npyHeader(exportAs(Exporter::Format::Npy, "cube"));
+        QVERIFY(cube.contains("'shape': (2, 2, 2)"));
+        QCOMPARE((10 + cube.size()) % 64, 0);
+    }
+
+    void csvLines()
+    {
+        // 1维每行一个值，N维每行是表格的一行，高维度的页接在后面
+        QCOMPARE(exportAs(Exporter::Format::Csv, "line"), QByteArray("1\n2\n3\n"));
+        QCOMPARE(exportAs(Exporter::Format::Csv, "matrix"), QByteArray("0.5,1,2\n10,11,12.25\n"));
+        QCOMPARE(exportAs(Exporter::Format::Tsv, "matrix"), QByteArray("0.5\t1\t2\n10\t11\t12.25\n"));
+        QCOMPARE(exportAs(Exporter::Format::Csv, "cube"), QByteArray("0,1\n2,3\n4,5\n6,7\n"));
+        QCOMPARE(exportAs(Exporter::Format::Csv, "bytes"), QByteArray("7\n200\n"));
+    }
+
+    void smallBlocks()
+    {
+        // 一行比块还大时一行分成几块，输出一样
+        QCOMPARE(exportAs(Exporter::Format::Csv, "matrix", 2 * sizeof(double)), QByteArray("0.5,1,2\n10,11,12.25\n"));
+        QCOMPARE(exportAs(Exporter::Format::Csv, "line", 1), QByteArray("1\n2\n3\n"));
+    }
+
+    void compoundText()
+    {
+        // 成员之间的逗号在CSV里要加引号
+        QCOMPARE(exportAs(Exporter::Format::Csv, "records"), QByteArray("\"{1,0.5}\"\n\"{2,1.5}\"\n"));
+        QCOMPARE(exportAs(Exporter::Format::Tsv, "records"), QByteArray("{1,0.5}\n{2,1.5}\n"));
+    }
+
+    void stringText()
+    {
+        QCOMPARE(exportAs(Exporter::Format::Csv, "names"), QByteArray("ab\n\"c,d\"\n\"x\"\"y\"\n"));
+        QCOMPARE(exportAs(Exporter::Format::Tsv, "texts"), QByteArray("hi\n\"a\tb\"\n"));
+        QCOMPARE(exportAs(Exporter::Format::Csv, "texts"), QByteArray("hi\na\tb\n"));
+    }
+
+    void unsupportedType()
+    {
+        QVERIFY_EXCEPTION_THROWN(exportAs(Exporter::Format::Npy, "texts"), std::runtime_error);
+        QVERIFY_EXCEPTION_THROWN(exportAs(Exporter::Format::Npy, "records"), std::runtime_error);
+    }
+};
+
+QTEST_GUILESS_MAIN(ExporterTest)
+#include "exporter_test.moc"
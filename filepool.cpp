@@ -0,0 +1,50 @@
+#include "prefix.h"
+#include "filepool.h"
+
+FilePool::FilePool(size_t capacity)
+: _capacity(std::max<size_t>(capacity, 1))
+{
+}
+
+FilePool::~FilePool()
+{
+    _lru.clear();
+}
+
+std::shared_ptr<HighFive::File> FilePool::acquire(const QString& fileName)
+{
+    auto itr = std::find_if(_lru.begin(), _lru.end(), [&](const Entry& e){ return e.fileName == fileName; });
+    if(itr != _lru.end())
+    {
+        _lru.splice(_lru.begin(), _lru, itr);
+        return _lru.front().file;
+    }
+    auto file = std::make_shared<HighFive::File>(fileName.toStdString());
+    _lru.push_front(Entry{fileName, file});
+    evict();
+    return file;
+}
+
+void FilePool::release(const QString& fileName)
+{
+    _lru.remove_if([&](const Entry& e){ return e.fileName == fileName; });
+}
+
+void FilePool::setEvicted(Evicted evicted)
+{
+    _evicted = std::move(evicted);
+}
+
+void FilePool::evict()
+{
+    // 从最久没用的开始关，正在用的跳过
+    auto itr = _lru.end();
+    while(_lru.size() > _capacity && itr != _lru.begin())
+    {
+        --itr;
+        if(itr->file.use_count() > 1) continue;
+        auto fileName = itr->fileName;
+        itr = _lru.erase(itr);
+        if(_evicted) _evicted(fileName);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef FILEPOOL_H
+#define FILEPOOL_H
+
+#include <QString>
+#include <list>
+
+// 打开的HDF5文件句柄池。同时打开的文件有上限，超过时关闭最久没用的，再用到时重新打开
+// 别处还拿着shared_ptr的文件（比如当前显示的文件）不会被关闭。所有函数都要拿着HDF5的锁调用
+class FilePool
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 8;
+    using Evicted = std::function<void(const QString& fileName)>; // 关闭之后通知，用来丢掉还引用这个文件的缓存
+
+    explicit FilePool(size_t capacity = DEFAULT_CAPACITY);
+    ~FilePool();
+
+    std::shared_ptr<HighFive::File> acquire(const QString& fileName); // 打不开时抛出异常
+    void release(const QString& fileName); // 马上关闭
+    void setEvicted(Evicted evicted);
+
+private:
+    void evict();
+
+    struct Entry
+    {
+        QString fileName;
+        std::shared_ptr<HighFive::File> file;
+    };
+    std::list<Entry> _lru; // 最近使用的在前面
+    size_t _capacity;
+    Evicted _evicted;
+};
+
+#endif
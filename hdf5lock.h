@@ -0,0 +1,15 @@
+#ifndef HDF5LOCK_H
+#define HDF5LOCK_H
+
+#include <mutex>
+
+// HDF5默认编译不是线程安全的，后台线程和界面线程调用HDF5（包括HighFive对象的构造和析构）前都要拿这个锁
+inline std::recursive_mutex& hdf5Mutex()
+{
+    static std::recursive_mutex mutex;
+    return mutex;
+}
+
+using H5Lock = std::lock_guard<std::recursive_mutex>;
+
+#endif
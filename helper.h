@@ -1,6 +1,8 @@
 #ifndef HELPER_H
 #define HELPER_H
 
+#include "cellformatter.h"
+
 class MyObj: public HighFive::Object
 {
 public:
@@ -8,15 +10,101 @@ public:
     :HighFive::Object(id){}
 };
 
-class MyTableRefItem : public QStandardItem
+// 用C API拿到的类型id（接管，析构时关闭）
+class MyType: public HighFive::DataType
 {
 public:
-    using QStandardItem::QStandardItem;
-    std::string path;
-    HighFive::ObjectType type;
+    explicit MyType(hid_t id)
+    :HighFive::DataType(id){}
 };
 
-QString getDisplayString(const void* data, HighFive::DataTypeClass class_type, size_t size)
+// 读出来的元素里有HDF5分配的内存（变长字符串、VLEN，也包括compound成员和数组元素里的），用完要H5Treclaim
+inline bool hasVlenData(hid_t type)
+{
+    if(H5Tis_variable_str(type) > 0 || H5Tdetect_class(type, H5T_VLEN) > 0) return true;
+    auto class_type = H5Tget_class(type);
+    if(class_type == H5T_COMPOUND)
+    {
+        int n = H5Tget_nmembers(type);
+        for(int i=0; i<n; i++)
+        {
+            hid_t member = H5Tget_member_type(type, (unsigned)i);
+            if(member < 0) continue;
+            bool vlen = hasVlenData(member);
+            H5Tclose(member);
+            if(vlen) return true;
+        }
+    }
+    else if(class_type == H5T_ARRAY)
+    {
+        hid_t base = H5Tget_super(type);
+        if(base < 0) return false;
+        bool vlen = hasVlenData(base);
+        H5Tclose(base);
+        return vlen;
+    }
+    return false;
+}
+
+// 变长字符串和VLEN的单元格，元素里只有指针，内容在HDF5分配的内存里
+// 字节的VLEN当作文本，数值的VLEN显示前几个元素
+struct VlenFormat
+{
+    static constexpr size_t MAX_ELEMENTS = 32;
+
+    bool variable_str{false};
+    size_t base_size{0}; // VLEN元素的大小
+    CellKernel kernel; // VLEN的元素是数值时
+
+    explicit operator bool() const { return variable_str || base_size > 0; }
+};
+
+inline VlenFormat selectVlenFormat(const HighFive::DataType& type)
+{
+    VlenFormat format;
+    auto class_type = type.getClass();
+    if(class_type == HighFive::DataTypeClass::String)
+    {
+        format.variable_str = type.isVariableStr();
+    }
+    else if(class_type == HighFive::DataTypeClass::VarLen)
+    {
+        MyType base(H5Tget_super(type.getId()));
+        format.base_size = base.getSize();
+        format.kernel = selectKernel(base);
+    }
+    return format;
+}
+
+// 直接指向HDF5分配的内存，不复制；读出它的块释放以后就失效了
+inline std::string_view vlenView(const void* data, const VlenFormat& format)
+{
+    if(format.variable_str)
+    {
+        auto p = *(const char* const*)data;
+        return p ? std::string_view(p) : std::string_view();
+    }
+    auto vl = (const hvl_t*)data;
+    return vl->p ? std::string_view((const char*)vl->p, vl->len * format.base_size) : std::string_view();
+}
+
+inline QString formatVlen(const void* data, const VlenFormat& format)
+{
+    if(format.variable_str || (format.base_size == 1 && !format.kernel))
+    {
+        auto text = vlenView(data, format);
+        return QString::fromUtf8(text.data(), (int)text.size());
+    }
+    auto vl = (const hvl_t*)data;
+    if(!format.kernel) return QString("VarLen: %1").arg(vl->len);
+    QStringList sl;
+    auto shown = std::min<size_t>(vl->len, VlenFormat::MAX_ELEMENTS);
+    for(size_t i=0; i<shown; i++) sl.append(formatCell(format.kernel, (const uint8_t*)vl->p + i * format.base_size));
+    if(shown < vl->len) sl.append(QString("… (%1)").arg(vl->len));
+    return "[" + sl.join(',') + "]";
+}
+
+inline QString getDisplayString(const void* data, HighFive::DataTypeClass class_type, size_t size)
 {
     QString str;
     switch(class_type)
@@ -49,8 +137,21 @@ QString getDisplayString(const void* data, HighFive::DataTypeClass class_type, s
     return str;
 }
 
+// 数值类型用按类型选好的格式化函数，能正确处理无符号数、半精度和大端数据；变长类型直接读指向的内容
+inline QString getDisplayString(const void* data, const HighFive::DataType& type)
+{
+    if(auto kernel = selectKernel(type))
+    {
+        return formatCell(kernel, data);
+    }
+    if(auto vlen = selectVlenFormat(type))
+    {
+        return formatVlen(data, vlen);
+    }
+    return getDisplayString(data, type.getClass(), type.getSize());
+}
 
-QString typeToStr(HighFive::ObjectType type)
+inline QString typeToStr(HighFive::ObjectType type)
 {
     switch(type)
     {
@@ -73,7 +174,32 @@ QString typeToStr(HighFive::ObjectType type)
     }
 }
 
-QString datasetTypeStr(const HighFive::DataSet& ds)
+inline HighFive::ObjectType toObjectType(H5O_type_t type)
+{
+    switch(type)
+    {
+    case H5O_TYPE_GROUP:
+        return HighFive::ObjectType::Group;
+    case H5O_TYPE_DATASET:
+        return HighFive::ObjectType::Dataset;
+    case H5O_TYPE_NAMED_DATATYPE:
+        return HighFive::ObjectType::UserDataType;
+    default:
+        return HighFive::ObjectType::Other;
+    }
+}
+
+// 对象在文件里的地址，区分同一个对象的多个链接
+inline std::string objectKey(const H5O_info_t& info)
+{
+#if H5_VERSION_GE(1,12,0)
+    return std::string((const char*)&info.token, sizeof(info.token));
+#else
+    return std::to_string(info.addr);
+#endif
+}
+
+inline QString datasetTypeStr(const HighFive::DataSet& ds)
 {
     auto data_type = ds.getDataType();
 
@@ -83,92 +209,33 @@ QString datasetTypeStr(const HighFive::DataSet& ds)
     return QString::fromStdString( HighFive::type_class_string(data_type.getClass()) ) + ": " + sl.join(L'×');
 }
 
-template<class Derivate>
-QList<QTreeWidgetItem *> appendGroupMember(QTreeWidgetItem* parent, const HighFive::NodeTraits<Derivate>& group)
+struct AttrRow
 {
-    QList<QTreeWidgetItem *> items;
-    if(parent) parent->setIcon(0, QIcon(":/icons/group"));
-    auto names = group.listObjectNames();
-    for(const auto& name : names)
-    {
-        auto type = group.getObjectType(name);
-        auto type_str = typeToStr(type);
-        QString iconPath;
-        if(type == HighFive::ObjectType::Dataset)
-        {
-            type_str = type_str + "(" + datasetTypeStr(group.getDataSet(name)) + ")";
-            iconPath = ":/icons/cells";
-        }
-        auto item = new QTreeWidgetItem(parent, QStringList{QString::fromStdString(name), type_str});
-        if(type == HighFive::ObjectType::Group) // add sub items
-        {
-            appendGroupMember(item, group.getGroup(name));
-        }
-        if(!iconPath.isEmpty())
-            item->setIcon(0, QIcon(iconPath));
-        items.append(item);
-    }
-    return items;
-}
-
-template <typename Derivate>
-void setTreeContent(QTreeWidget* treeWidget, const HighFive::NodeTraits<Derivate>& node)
-{
-    auto items = appendGroupMember(nullptr, node);
-    treeWidget->clear();
-    treeWidget->insertTopLevelItems(0, items);
-}
+    QString name;
+    QString type;
+    QString value;
+    bool lazy{false}; // 值太大还没有读，value里是大小
+};
 
-template <typename Derivate>
-void showAttrib(QTableWidget* table, const HighFive::AnnotateTraits<Derivate>& obj)
+inline void showAttrib(QTableWidget* table, const QVector<AttrRow>& rows)
 {
     table->clear();
     table->setColumnCount(3);
     table->setHorizontalHeaderLabels({QObject::tr("Name"), QObject::tr("Type"), QObject::tr("Value")});
-    table->setRowCount((int)obj.getNumberAttributes());
+    table->setRowCount(rows.size());
     int row = 0;
-    for(const auto &name : obj.listAttributeNames())
-    {
-        table->setItem(row, 0,  new QTableWidgetItem(QString::fromStdString(name)));
-
-        auto attr = obj.getAttribute(name);
-        auto data_type = attr.getDataType();
-        auto class_type= data_type.getClass();
-        auto size = data_type.getSize();
-        auto space = attr.getMemSpace();
-        auto eleCount = space.getElementCount();
-
-        table->setItem(row, 1,  new QTableWidgetItem(QString::fromStdString(HighFive::type_class_string(class_type))));
-        
-        try{
-            std::vector<uint8_t> buff(size * std::max<size_t>(1,eleCount), 0);
-            attr.read(buff.data(), data_type);
-
-            QString val;            
-            if(class_type == HighFive::DataTypeClass::VarLen)
-            {
-                hvl_t *fieldnames_vl = (hvl_t*)buff.data();
-                QStringList sl;
-                std::transform(fieldnames_vl, fieldnames_vl + eleCount, std::back_inserter(sl), [](const hvl_t& vl){ return QString::fromLatin1((const char*)vl.p, (int)vl.len); } );
-                val = sl.join(',');
-                H5Treclaim(data_type.getId(), space.getId(), H5P_DEFAULT, fieldnames_vl);
-            }
-            else
-            {
-                val = getDisplayString(&buff[0], class_type, size);
-            }
-            table->setItem(row, 2,  new QTableWidgetItem(val));
-        }
-        catch(...)
-        {
-
-        }
-
+    for(const auto& attr : rows)
+    {
+        table->setItem(row, 0,  new QTableWidgetItem(attr.name));
+        table->setItem(row, 1,  new QTableWidgetItem(attr.type));
+        auto value = new QTableWidgetItem(attr.value);
+        if(attr.lazy) value->setToolTip(QObject::tr("Double-click to read the value"));
+        table->setItem(row, 2,  value);
         row++;
     }
 }
 
-bool samePath(const QString& p1, const QString& p2)
+inline bool samePath(const QString& p1, const QString& p2)
 {
     auto path_str1 = p1.toStdString();
     if(p1.startsWith('/'))
@@ -185,7 +252,7 @@ bool samePath(const QString& p1, const QString& p2)
     return path_str1 == path_str2;
 }
 
-QString getTreePath(QTreeWidgetItem *item)
+inline QString getTreePath(QTreeWidgetItem *item)
 {
     auto tokens = std::make_unique<QStringList>(); 
     while(item)
@@ -197,7 +264,7 @@ QString getTreePath(QTreeWidgetItem *item)
 }
 
 
-QString handlePath(const HighFive::File& file, const QString& path,
+inline QString handlePath(const HighFive::File& file, const QString& path,
     std::function<void(const HighFive::File&)> hf,
     std::function<void(const HighFive::DataSet&)> hd,
     std::function<void(const HighFive::Group&)> hg,
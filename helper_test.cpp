@@ -0,0 +1,78 @@
+#include "prefix.h"
+#include "helper.h"
+#include <numeric>
+#include <QtTest>
+
+// 变长数据的判断和格式化：元素里只有指针，内容在别处
+class HelperTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void detectVlen()
+    {
+        QVERIFY(!hasVlenData(H5T_NATIVE_INT));
+        QVERIFY(!hasVlenData(H5T_C_S1));
+
+        MyType str(H5Tcopy(H5T_C_S1));
+        H5Tset_size(str.getId(), H5T_VARIABLE);
+        QVERIFY(hasVlenData(str.getId()));
+
+        MyType vl(H5Tvlen_create(H5T_NATIVE_DOUBLE));
+        QVERIFY(hasVlenData(vl.getId()));
+
+        // compound成员和数组元素里的变长数据也要释放
+        MyType record(H5Tcreate(H5T_COMPOUND, sizeof(int) + sizeof(char*)));
+        H5Tinsert(record.getId(), "id", 0, H5T_NATIVE_INT);
+        H5Tinsert(record.getId(), "name", sizeof(int), str.getId());
+        QVERIFY(hasVlenData(record.getId()));
+
+        hsize_t n = 3;
+        MyType array(H5Tarray_create2(str.getId(), 1, &n));
+        QVERIFY(hasVlenData(array.getId()));
+        MyType plain(H5Tarray_create2(H5T_NATIVE_INT, 1, &n));
+        QVERIFY(!hasVlenData(plain.getId()));
+    }
+
+    void formatVariableString()
+    {
+        MyType str(H5Tcopy(H5T_C_S1));
+        H5Tset_size(str.getId(), H5T_VARIABLE);
+        auto format = selectVlenFormat(str);
+        QVERIFY(format.variable_str);
+
+        const char* text = "h\xc3\xa9llo";
+        QCOMPARE(vlenView(&text, format), std::string_view(text));
+        QCOMPARE(formatVlen(&text, format), QString::fromUtf8("héllo"));
+        const char* null = nullptr;
+        QVERIFY(formatVlen(&null, format).isEmpty());
+    }
+
+    void formatNumberVlen()
+    {
+        MyType vl(H5Tvlen_create(H5T_NATIVE_INT));
+        auto format = selectVlenFormat(vl);
+        QCOMPARE(format.base_size, sizeof(int));
+        QVERIFY(format.kernel);
+
+        std::vector<int> values(VlenFormat::MAX_ELEMENTS + 8);
+        std::iota(values.begin(), values.end(), 0);
+        hvl_t short_vl{3, values.data()};
+        QCOMPARE(formatVlen(&short_vl, format), QString("[0,1,2]"));
+        // 太长的只显示前面几个和总个数
+        hvl_t long_vl{values.size(), values.data()};
+        QVERIFY(formatVlen(&long_vl, format).endsWith(QString::fromUtf8("… (40)]")));
+    }
+
+    void byteVlenView()
+    {
+        MyType vl(H5Tvlen_create(H5T_NATIVE_CHAR));
+        auto format = selectVlenFormat(vl);
+        char bytes[] = {'a', 'b', 'c'};
+        hvl_t text{3, bytes};
+        QCOMPARE(vlenView(&text, format), std::string_view("abc"));
+    }
+};
+
+QTEST_GUILESS_MAIN(HelperTest)
+#include "helper_test.moc"
@@ -0,0 +1,175 @@
+#include "prefix.h"
+#include "ioexecutor.h"
+#include "hdf5lock.h"
+#include <QThread>
+
+namespace
+{
+    constexpr int IO_THREAD_COUNT = 2;
+    constexpr int BACKGROUND_THREAD_COUNT = 1;
+}
+
+class IoRunnable : public QRunnable
+{
+public:
+    IoRunnable(std::shared_ptr<IoTask> task, bool background)
+    : _task(std::move(task)), _background(background)
+    {
+    }
+
+    void run() override
+    {
+        auto& task = *_task;
+        if(_background) QThread::currentThread()->setPriority(QThread::LowestPriority);
+        if(!task.isCancelled())
+        {
+            try {
+                task._result = task._work(task);
+            }
+            catch(const std::exception& ex) {
+                task._error = QString::fromLocal8Bit(ex.what());
+            }
+        }
+        {
+            // Work里可能捕获了HighFive对象，析构时也要拿锁
+            H5Lock lock(hdf5Mutex());
+            task._work = nullptr;
+        }
+        emit task._executor->workDone(task._id);
+    }
+
+private:
+    std::shared_ptr<IoTask> _task;
+    bool _background;
+};
+
+IoTask::IoTask(IoExecutor* executor, quint64 id, QString title, Work work, QObject* context)
+: _executor(executor), _id(id), _title(std::move(title)), _work(std::move(work)), _context(context), _has_context(context != nullptr)
+{
+}
+
+IoTask::~IoTask()
+{
+    H5Lock lock(hdf5Mutex());
+    _work = nullptr;
+    _result = nullptr;
+    _partials.clear();
+}
+
+void IoTask::cancel()
+{
+    _cancelled = true;
+}
+
+bool IoTask::isCancelled() const
+{
+    return _cancelled;
+}
+
+const QString& IoTask::title() const
+{
+    return _title;
+}
+
+void IoTask::setProgress(size_t done, size_t total)
+{
+    if(_title.isEmpty() || total == 0 || isCancelled()) return;
+    int percent = (int)(std::min(done, total) * 100 / total);
+    if(_percent.exchange(percent) != percent)
+    {
+        emit _executor->progressChanged(_title, percent);
+    }
+}
+
+void IoTask::post(Result partial)
+{
+    if(isCancelled()) return;
+    {
+        std::lock_guard<std::mutex> lock(_partial_mutex);
+        _partials.push_back(std::move(partial));
+    }
+    emit _executor->partialReady(_id);
+}
+
+IoExecutor::IoExecutor(QObject *parent)
+: QObject(parent)
+{
+    _pool.setMaxThreadCount(IO_THREAD_COUNT);
+    _background_pool.setMaxThreadCount(BACKGROUND_THREAD_COUNT);
+    connect(this, &IoExecutor::workDone, this, &IoExecutor::onWorkDone, Qt::QueuedConnection);
+    connect(this, &IoExecutor::partialReady, this, &IoExecutor::onPartialReady, Qt::QueuedConnection);
+}
+
+IoExecutor::~IoExecutor()
+{
+    cancelAll();
+    _pool.waitForDone();
+    _background_pool.waitForDone();
+    _tasks.clear();
+}
+
+std::shared_ptr<IoTask> IoExecutor::submit(const QString& title, IoTask::Work work, QObject* context, Priority priority)
+{
+    auto id = _next_id++;
+    std::shared_ptr<IoTask> task(new IoTask(this, id, title, std::move(work), context));
+    _tasks.insert(id, task);
+    bool background = priority == Priority::Background;
+    (background ? _background_pool : _pool).start(new IoRunnable(task, background));
+    return task;
+}
+
+void IoExecutor::cancelAll()
+{
+    for(auto& task : _tasks)
+    {
+        task->cancel();
+    }
+}
+
+bool IoExecutor::isStale(const IoTask& task) const
+{
+    return task.isCancelled() || (task._has_context && !task._context);
+}
+
+void IoExecutor::onPartialReady(quint64 id)
+{
+    auto task = _tasks.value(id);
+    if(!task || isStale(*task)) return;
+
+    std::vector<IoTask::Result> partials;
+    {
+        std::lock_guard<std::mutex> lock(task->_partial_mutex);
+        partials.swap(task->_partials);
+    }
+    // 回调里访问HDF5的地方自己拿锁，这里只在释放时拿锁（回调可能捕获了HighFive对象）
+    for(auto& partial : partials)
+    {
+        if(isStale(*task)) break;
+        partial();
+    }
+    H5Lock lock(hdf5Mutex());
+    partials.clear();
+}
+
+void IoExecutor::onWorkDone(quint64 id)
+{
+    auto task = _tasks.take(id);
+    if(!task || isStale(*task)) return; // 过期的结果直接丢弃
+
+    if(!task->_error.isEmpty())
+    {
+        emit taskFailed(task->_title, task->_error);
+        return;
+    }
+    if(auto result = std::move(task->_result))
+    {
+        task->_result = nullptr;
+        result();
+        H5Lock lock(hdf5Mutex());
+        result = nullptr;
+    }
+    if(!task->_title.isEmpty())
+    {
+        emit taskFinished(task->_title);
+    }
+}
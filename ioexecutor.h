@@ -0,0 +1,83 @@
+#ifndef IOEXECUTOR_H
+#define IOEXECUTOR_H
+
+#include <QObject>
+#include <QPointer>
+#include <QThreadPool>
+#include <QHash>
+#include <atomic>
+#include <mutex>
+
+class IoExecutor;
+
+// 后台读取任务。Work在后台线程执行，返回的Result在界面线程执行；任务被取消或context已经销毁时Result被丢弃
+// Result执行时不拿HDF5的锁，里面调用HDF5的地方要自己拿锁
+class IoTask
+{
+public:
+    using Result = std::function<void()>;
+    using Work = std::function<Result(IoTask&)>;
+
+    ~IoTask();
+
+    void cancel();
+    bool isCancelled() const;
+    void setProgress(size_t done, size_t total); // 后台线程调用，通过IoExecutor::progressChanged显示
+    void post(Result partial); // 后台线程调用，先把部分结果交给界面线程执行
+    const QString& title() const;
+
+private:
+    friend class IoExecutor;
+    friend class IoRunnable;
+    IoTask(IoExecutor* executor, quint64 id, QString title, Work work, QObject* context);
+
+    IoExecutor* _executor;
+    quint64 _id;
+    QString _title;
+    Work _work;
+    Result _result;
+    std::mutex _partial_mutex;
+    std::vector<Result> _partials;
+    QString _error;
+    QPointer<QObject> _context;
+    bool _has_context;
+    std::atomic<bool> _cancelled{false};
+    std::atomic<int> _percent{-1};
+};
+
+class IoExecutor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IoExecutor(QObject *parent = nullptr);
+    ~IoExecutor(); // 取消所有任务并等待后台线程结束
+
+    // 遍历整个文件这样很久的任务用Background，在单独的低优先级线程里运行，不占用读取数据的线程
+    enum class Priority { Normal, Background };
+
+    // title为空的任务不报告进度
+    std::shared_ptr<IoTask> submit(const QString& title, IoTask::Work work, QObject* context = nullptr, Priority priority = Priority::Normal);
+    void cancelAll();
+
+signals:
+    void progressChanged(QString title, int percent);
+    void taskFinished(QString title);
+    void taskFailed(QString title, QString message);
+    void workDone(quint64 id);
+    void partialReady(quint64 id);
+
+private slots:
+    void onWorkDone(quint64 id);
+    void onPartialReady(quint64 id);
+
+private:
+    bool isStale(const IoTask& task) const;
+
+    QThreadPool _pool;
+    QThreadPool _background_pool;
+    QHash<quint64, std::shared_ptr<IoTask>> _tasks;
+    quint64 _next_id{1};
+};
+
+#endif
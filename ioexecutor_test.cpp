@@ -0,0 +1,104 @@
+#include "prefix.h"
+#include "ioexecutor.h"
+#include "hdf5lock.h"
+#include <QSignalSpy>
+#include <QtTest>
+#include <thread>
+
+// 结果和部分结果在界面线程按顺序执行，取消以后结果被丢弃
+class IoExecutorTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void resultRunsOnGuiThread()
+    {
+        IoExecutor executor;
+        QThread* worker = nullptr;
+        QThread* result = nullptr;
+        executor.submit("load", [&](IoTask&) -> IoTask::Result {
+            worker = QThread::currentThread();
+            return [&](){ result = QThread::currentThread(); };
+        });
+        QTRY_VERIFY(result);
+        QVERIFY(worker != QThread::currentThread());
+        QCOMPARE(result, QThread::currentThread());
+    }
+
+    void resultRunsWithoutHdf5Lock()
+    {
+        // 界面线程执行结果时不拿HDF5的锁，后台线程这时可以拿到
+        IoExecutor executor;
+        bool checked = false, free = false;
+        executor.submit({}, [&](IoTask&) -> IoTask::Result {
+            return [&](){
+                std::thread other([&]{
+                    free = hdf5Mutex().try_lock();
+                    if(free) hdf5Mutex().unlock();
+                });
+                other.join();
+                checked = true;
+            };
+        });
+        QTRY_VERIFY(checked);
+        QVERIFY(free);
+    }
+
+    void partialsBeforeResult()
+    {
+        IoExecutor executor;
+        QStringList order;
+        executor.submit({}, [&](IoTask& task) -> IoTask::Result {
+            task.post([&](){ order.append("attrs"); });
+            task.post([&](){ order.append("page"); });
+            return [&](){ order.append("done"); };
+        });
+        QTRY_COMPARE(order.size(), 3);
+        QCOMPARE(order, (QStringList{"attrs", "page", "done"}));
+    }
+
+    void cancelledResultIsDropped()
+    {
+        IoExecutor executor;
+        std::atomic<bool> started{false}, cancelled{false};
+        bool ran = false;
+        auto task = executor.submit({}, [&](IoTask& task) -> IoTask::Result {
+            started = true;
+            while(!task.isCancelled()) QThread::msleep(1);
+            cancelled = true;
+            return [&](){ ran = true; };
+        });
+        QSignalSpy done(&executor, &IoExecutor::workDone);
+        QTRY_VERIFY(started);
+        task->cancel();
+        QTRY_COMPARE(done.count(), 1);
+        QVERIFY(cancelled);
+        QCoreApplication::processEvents(); // onWorkDone已经执行过
+        QVERIFY(!ran);
+    }
+
+    void failureIsReported()
+    {
+        IoExecutor executor;
+        QSignalSpy failed(&executor, &IoExecutor::taskFailed);
+        executor.submit("broken", [](IoTask&) -> IoTask::Result {
+            throw std::runtime_error("bad dataset");
+        });
+        QVERIFY(failed.wait());
+        QCOMPARE(failed.first().at(0).toString(), QString("broken"));
+        QCOMPARE(failed.first().at(1).toString(), QString("bad dataset"));
+    }
+
+    void backgroundTaskRuns()
+    {
+        IoExecutor executor;
+        bool ran = false;
+        executor.submit({}, [&](IoTask&) -> IoTask::Result {
+            return [&](){ ran = true; };
+        }, nullptr, IoExecutor::Priority::Background);
+        QTRY_VERIFY(ran);
+    }
+};
+
+QTEST_GUILESS_MAIN(IoExecutorTest)
+#include "ioexecutor_test.moc"
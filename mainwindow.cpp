@@ -2,6 +2,9 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "helper.h"
+#include "hdf5lock.h"
+#include "matfile.h"
+#include <QElapsedTimer>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -9,8 +12,34 @@ MainWindow::MainWindow(QWidget *parent) :
 {
     ui->setupUi(this);
     initTree();
+    ui->listSearch->hide();
+    ui->plotView->hide();
+    tabFiles = new QTabBar(ui->centralWidget);
+    tabFiles->setTabsClosable(true);
+    tabFiles->setDocumentMode(true);
+    tabFiles->setExpanding(false);
+    ui->verticalLayout_2->insertWidget(1, tabFiles);
+    filePool = std::make_unique<FilePool>();
+    filePool->setEvicted([this](const QString& fileName){
+        // 文件已经关了，引用它的RefResolver也要丢掉，切换回来时重建
+        if(auto s = findSession(fileName)) s->refResolver.reset();
+    });
+    treeLoader = std::make_unique<TreeLoader>(ui->tree);
+    ioExecutor = std::make_unique<IoExecutor>();
 
-    connect(ui->cbxDataPages, SIGNAL(currentIndexChanged(int)),  this, SLOT(showPage(int)));
+    connect(ioExecutor.get(), &IoExecutor::progressChanged, this, &MainWindow::onTaskProgress);
+    connect(ioExecutor.get(), &IoExecutor::taskFinished, this, &MainWindow::onTaskFinished);
+    connect(ioExecutor.get(), &IoExecutor::taskFailed, this, &MainWindow::onTaskFailed);
+    connect(tabFiles, &QTabBar::currentChanged, this, &MainWindow::activateSession);
+    connect(tabFiles, &QTabBar::tabCloseRequested, this, &MainWindow::closeSession);
+
+    menuFields = new QMenu(this);
+    actionSplitMembers = new QAction(tr("One Column per Member"), this);
+    actionSplitMembers->setCheckable(true);
+    actionSplitMembers->setChecked(true);
+    ui->btnFields->setMenu(menuFields);
+    ui->btnFields->setVisible(false);
+    connect(menuFields, SIGNAL(triggered(QAction*)), this, SLOT(onFieldsTriggered(QAction*)));
 }
 
 void MainWindow::initTree()
@@ -21,41 +50,286 @@ void MainWindow::initTree()
 
 MainWindow::~MainWindow()
 {
+    // 先等后台线程结束
+    ioExecutor.reset();
+    treeLoader.reset();
     delete ui;
 }
 
 void MainWindow::on_actionOpen_triggered()
 {
-    auto fileName = QFileDialog::getOpenFileName(this,
+    auto fileNames = QFileDialog::getOpenFileNames(this,
       tr("Open HDF5 Files"), "", tr("HDF5 Files (*.*)"));
-    if(fileName.isNull() || fileName.isEmpty()) return;
-    curr_dataset.reset();
-    pagerPtr.reset();
-    file_ptr = std::make_unique<HighFive::File>(fileName.toStdString());
-    gotoPath("", GotoMode::Init);
+    for(const auto& fileName : fileNames) openFile(fileName);
+}
+
+MainWindow::FileSession* MainWindow::findSession(const QString& fileName)
+{
+    auto itr = std::find_if(sessions.begin(), sessions.end(), [&](const FileSession& s){ return s.fileName == fileName; });
+    return itr == sessions.end() ? nullptr : &*itr;
+}
+
+void MainWindow::openFile(const QString& fileName)
+{
+    // 已经打开的文件直接切换过去
+    auto absName = QFileInfo(fileName).absoluteFilePath();
+    if(auto session = findSession(absName))
+    {
+        tabFiles->setCurrentIndex(int(session - sessions.data()));
+        return;
+    }
+    try{
+        H5Lock lock(hdf5Mutex());
+        filePool->acquire(absName);
+        ChunkCache::instance().removeFile(absName.toStdString()); // 同名文件可能已经改过
+    }
+    catch(const HighFive::Exception& ex) {
+        QMessageBox::critical(this, tr("HDF5 PAD"),
+                               ex.what(),
+                               QMessageBox::Ok);
+        return;
+    }
+    FileSession session;
+    session.fileName = absName;
+    session.attrCache = std::make_shared<AttrCache>();
+    sessions.push_back(std::move(session));
+    auto idx = tabFiles->addTab(QFileInfo(absName).fileName());
+    tabFiles->setTabToolTip(idx, absName);
+    tabFiles->setCurrentIndex(idx);
+}
+
+void MainWindow::saveSession()
+{
+    if(curr_session < 0 || curr_session >= (int)sessions.size()) return;
+    auto& s = sessions[curr_session];
+    s.root_path = root_path;
+    s.back_paths = back_paths;
+    s.forward_paths = forward_paths;
+    s.refResolver = refResolver;
+    s.metaIndex = metaIndex;
+    s.pathSearch = pathSearch;
+}
+
+void MainWindow::activateSession(int idx)
+{
+    if(idx == curr_session && idx >= 0) return;
+    saveSession();
+    curr_session = idx;
+    treeLoader->cancel();
+    clearItemViewer();
+    {
+        // 预读的数据集属于上一个文件
+        H5Lock lock(hdf5Mutex());
+        prefetched.clear();
+    }
+    if(searchTask) searchTask->cancel();
+    ui->listSearch->clear();
+    ui->listSearch->hide();
+
+    if(idx < 0 || idx >= (int)sessions.size())
+    {
+        {
+            H5Lock lock(hdf5Mutex());
+            file_ptr.reset();
+            refResolver.reset();
+        }
+        metaIndex.reset();
+        pathSearch.reset();
+        attrCache.reset();
+        treeLoader->setIndex(nullptr);
+        ui->tree->clear();
+        root_path.clear();
+        back_paths.clear();
+        forward_paths.clear();
+        ui->edtPath->clear();
+        updateUI();
+        return;
+    }
+
+    // 文件句柄可能已经被FilePool关了，重新打开；索引、搜索索引和chunk缓存都还在
+    auto& s = sessions[idx];
+    try{
+        H5Lock lock(hdf5Mutex());
+        file_ptr = filePool->acquire(s.fileName);
+        if(!s.refResolver) s.refResolver = std::make_shared<RefResolver>(*file_ptr);
+        refResolver = s.refResolver;
+    }
+    catch(const HighFive::Exception& ex) {
+        {
+            H5Lock lock(hdf5Mutex());
+            file_ptr.reset();
+            refResolver.reset();
+        }
+        ui->tree->clear();
+        QMessageBox::critical(this, tr("HDF5 PAD"),
+                               ex.what(),
+                               QMessageBox::Ok);
+        return;
+    }
+    metaIndex = s.metaIndex;
+    pathSearch = s.pathSearch;
+    attrCache = s.attrCache;
+    treeLoader->setIndex(metaIndex);
+    if(!s.indexTask)
+    {
+        if(!metaIndex) openIndex(s);
+        else if(!pathSearch) buildSearch(s);
+    }
+
+    auto back = s.back_paths;
+    auto forward = s.forward_paths;
+    gotoPath(s.root_path, GotoMode::Init);
+    back_paths = back;
+    forward_paths = forward;
+    updateUI();
+}
+
+void MainWindow::closeSession(int idx)
+{
+    if(idx < 0 || idx >= (int)sessions.size()) return;
+    auto fileName = sessions[idx].fileName;
+    if(sessions[idx].indexTask) sessions[idx].indexTask->cancel();
+    if(idx == curr_session)
+    {
+        treeLoader->cancel();
+        clearItemViewer();
+        curr_session = -1; // 删掉标签页后激活新的当前页
+        H5Lock lock(hdf5Mutex());
+        file_ptr.reset();
+        refResolver.reset();
+    }
+    else if(idx < curr_session)
+    {
+        curr_session--;
+    }
+    {
+        H5Lock lock(hdf5Mutex());
+        sessions.erase(sessions.begin() + idx);
+        filePool->release(fileName);
+    }
+    ChunkCache::instance().removeFile(fileName.toStdString());
+    tabFiles->removeTab(idx);
+    if(tabFiles->count() == 0) activateSession(-1);
+}
+
+void MainWindow::openIndex(FileSession& session)
+{
+    auto fileName = session.fileName;
+    session.metaIndex = MetaIndex::open(fileName);
+    if(session.metaIndex)
+    {
+        onIndexReady(fileName, session.metaIndex);
+        return;
+    }
+
+    // 文件没有索引或者改过，在后台重建，下次打开时直接用；切换到别的文件时继续建
+    std::optional<HighFive::File> file;
+    {
+        H5Lock lock(hdf5Mutex());
+        file.emplace(*filePool->acquire(fileName));
+    }
+    session.indexTask = ioExecutor->submit(tr("Indexing %1").arg(QFileInfo(fileName).fileName()),
+        [file = std::make_shared<std::optional<HighFive::File>>(std::move(file)), fileName, this](IoTask& task) -> IoTask::Result {
+        auto index = MetaIndex::build(**file, fileName, [&task](size_t){ return task.isCancelled(); });
+        {
+            H5Lock lock(hdf5Mutex());
+            file->reset();
+        }
+        return [this, fileName, index](){
+            if(auto s = findSession(fileName)) s->indexTask.reset();
+            if(index) onIndexReady(fileName, index);
+        };
+    }, this, IoExecutor::Priority::Background);
+}
+
+void MainWindow::onIndexReady(const QString& fileName, std::shared_ptr<const MetaIndex> index)
+{
+    auto session = findSession(fileName);
+    if(!session) return;
+    session->metaIndex = index;
+    if(session - sessions.data() == curr_session)
+    {
+        metaIndex = index;
+        treeLoader->setIndex(metaIndex);
+    }
+    buildSearch(*session);
+}
+
+void MainWindow::buildSearch(FileSession& session)
+{
+    // 搜索索引只用到MetaIndex，不需要HDF5的锁
+    auto fileName = session.fileName;
+    session.indexTask = ioExecutor->submit(QString(), [this, fileName, index = session.metaIndex](IoTask& task) -> IoTask::Result {
+        auto search = std::make_shared<const PathSearch>(index);
+        if(task.isCancelled()) return {};
+        return [this, fileName, search](){
+            auto s = findSession(fileName);
+            if(!s) return;
+            s->indexTask.reset();
+            s->pathSearch = search;
+            if(s - sessions.data() == curr_session) pathSearch = search;
+        };
+    }, this);
+}
+
+void MainWindow::on_edtSearch_returnPressed()
+{
+    auto query = ui->edtSearch->text();
+    if(searchTask) searchTask->cancel();
+    ui->listSearch->clear();
+    if(query.isEmpty())
+    {
+        ui->listSearch->hide();
+        return;
+    }
+    if(!pathSearch)
+    {
+        ui->statusBar->showMessage(tr("Search index is not ready yet"), 3000);
+        return;
+    }
+
+    constexpr size_t MAX_RESULTS = 1000;
+    searchTask = ioExecutor->submit(QString(), [this, query, search = pathSearch](IoTask& task) -> IoTask::Result {
+        QElapsedTimer timer;
+        timer.start();
+        auto paths = search->find(query, MAX_RESULTS, [&task]{ return task.isCancelled(); });
+        auto ms = timer.elapsed();
+        return [this, paths, ms](){
+            for(const auto& path : paths)
+            {
+                auto item = new QListWidgetItem(path, ui->listSearch);
+                item->setData(Qt::UserRole, path);
+            }
+            ui->listSearch->show();
+            ui->statusBar->showMessage(tr("%1 results in %2 ms").arg(paths.size()).arg(ms), 3000);
+        };
+    }, this);
+}
+
+void MainWindow::on_listSearch_itemActivated(QListWidgetItem *item)
+{
+    if(!item) return;
+    gotoPath(item->data(Qt::UserRole).toString(), GotoMode::Normal);
 }
 
 void MainWindow::gotoPath(const QString& path, GotoMode mode)
 {
+    treeLoader->cancel();
     ui->tree->clear();
     clearItemViewer();
     if(!file_ptr) return;
 
     try{
+        H5Lock lock(hdf5Mutex());
         QString new_path = handlePath(
             *file_ptr,
             path,
             [this](const HighFive::File& f){
-                setTreeContent(ui->tree,f);
-                ::showAttrib(ui->tableAttr, f);
-            },
-            [this](const HighFive::DataSet& d){
-                ::showAttrib(ui->tableAttr, d);
-                showData(d);
+                treeLoader->setRoot(f, "");
             },
+            [](const HighFive::DataSet&){},
             [this](const HighFive::Group& g){
-                setTreeContent(ui->tree,g);
-                ::showAttrib(ui->tableAttr, g);
+                treeLoader->setRoot(*file_ptr, g.getPath());
             },
             [](){}
             );
@@ -84,6 +358,7 @@ void MainWindow::gotoPath(const QString& path, GotoMode mode)
         }
         root_path = new_path;
         ui->edtPath->setText(new_path);
+        showItemViewer(new_path);
         updateUI();
     }
     catch(const HighFive::Exception& ex) {
@@ -105,26 +380,72 @@ void MainWindow::on_actionForward_triggered()
     gotoPath(path, GotoMode::Forward);
 }
 
-void MainWindow::on_actionCopy_triggered()
+QVector<QRect> MainWindow::selectedRanges() const
 {
-    auto tableData = dynamic_cast<QStandardItemModel*>(ui->tableView->model());
-    if(!tableData) return;
-    int row = tableData->rowCount();
-    int col = tableData->columnCount();
-
-    QStringList lines;
-    for(int r=0; r<row; r++)
+    // 每个选中的矩形，没有选中时是整页
+    auto tableData = dynamic_cast<DataTableModel*>(ui->tableView->model());
+    if(!tableData) return {};
+    QVector<QRect> ranges;
+    if(auto selection = ui->tableView->selectionModel())
     {
-        QStringList items;
-        for(int c=0; c<col; c++)
+        for(auto& range : selection->selection())
         {
-            items.append( tableData->item(r, c)->text() );
+            ranges.append(QRect(QPoint(range.left(), range.top()), QPoint(range.right(), range.bottom())));
         }
-        lines.append(items.join('\t'));
     }
+    if(ranges.empty()) ranges.append(QRect(0, 0, tableData->columnCount(), tableData->rowCount()));
+    return ranges;
+}
+
+void MainWindow::on_actionCopy_triggered()
+{
+    auto tableData = dynamic_cast<DataTableModel*>(ui->tableView->model());
+    if(!tableData) return;
 
-    QClipboard *clipboard = QApplication::clipboard();
-    clipboard->setText(lines.join('\n'));
+    // 在后台格式化到一块按估计大小预留好的缓冲区，完成后只转换一次放进剪贴板
+    auto writer = tableData->regionWriter(selectedRanges(), '\t');
+    ioExecutor->submit(tr("Copy"), [writer](IoTask& task) -> IoTask::Result {
+        auto text = std::make_shared<std::string>();
+        bool done = writer(task, [&text](std::string_view part, size_t done, size_t total){
+            if(text->empty()) text->reserve(part.size() * total / done + part.size());
+            text->append(part);
+            return true;
+        });
+        if(!done) return {};
+        if(!text->empty()) text->pop_back(); // 最后一行不要换行
+        return [text](){
+            QApplication::clipboard()->setText(QString::fromUtf8(text->data(), (int)text->size()));
+        };
+    }, this);
+}
+
+void MainWindow::on_actionSave_triggered()
+{
+    auto tableData = dynamic_cast<DataTableModel*>(ui->tableView->model());
+    if(!tableData) return;
+    QString filter;
+    auto fileName = QFileDialog::getSaveFileName(this,
+      tr("Save Selection"), "", tr("Tab Separated (*.tsv *.txt);;CSV (*.csv)"), &filter);
+    if(fileName.isEmpty()) return;
+    char sep = fileName.endsWith(".csv", Qt::CaseInsensitive) || filter.startsWith("CSV") ? ',' : '\t';
+
+    // 边格式化边写文件
+    auto writer = tableData->regionWriter(selectedRanges(), sep);
+    ioExecutor->submit(tr("Save"), [writer, fileName](IoTask& task) -> IoTask::Result {
+        QFile file(fileName);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            throw std::runtime_error("Unable to create " + fileName.toStdString());
+        }
+        writer(task, [&file](std::string_view part, size_t, size_t){
+            if(file.write(part.data(), (qint64)part.size()) != (qint64)part.size())
+            {
+                throw std::runtime_error(file.errorString().toStdString());
+            }
+            return true;
+        });
+        return {};
+    }, this);
 }
 
 void MainWindow::on_btnGo_clicked()
@@ -135,7 +456,7 @@ void MainWindow::on_btnGo_clicked()
 
 void MainWindow::on_tree_itemDoubleClicked(QTreeWidgetItem *item, int column)
 {
-    if(!item) return;
+    if(!item || !item->data(0, Qt::UserRole).isValid()) return; // "Loading..."占位节点
     gotoPath(root_path + "/" + getTreePath(item), GotoMode::Normal);
 }
 
@@ -150,6 +471,7 @@ void MainWindow::on_btnUp_clicked()
 void MainWindow::on_tree_itemSelectionChanged()
 {
     auto items = ui->tree->selectedItems();
+    if(!items.empty() && !items.first()->data(0, Qt::UserRole).isValid()) return; // "Loading..."占位节点
     if(items.empty())
     {
         clearItemViewer();
@@ -157,57 +479,174 @@ void MainWindow::on_tree_itemSelectionChanged()
     else
     {
         showItemViewer(root_path + "/" +getTreePath(items.first()));
+        prefetchNeighbours(items.first());
+    }
+}
+
+void MainWindow::prefetchNeighbours(QTreeWidgetItem* item)
+{
+    // 方向键一般是往下走，多预读几个下面的
+    constexpr int PREFETCH_BELOW = 3;
+    constexpr int PREFETCH_ABOVE = 1;
+    QStringList paths;
+    auto add = [&](QTreeWidgetItem* neighbour){
+        auto path = root_path + "/" + getTreePath(neighbour);
+        auto itr = std::find_if(prefetched.begin(), prefetched.end(), [&](const auto& p){ return p.first == path; });
+        if(itr == prefetched.end()) paths.append(path);
+    };
+    auto next = item;
+    for(int i=0; i<PREFETCH_BELOW && (next = ui->tree->itemBelow(next)); i++) add(next);
+    auto prev = item;
+    for(int i=0; i<PREFETCH_ABOVE && (prev = ui->tree->itemAbove(prev)); i++) add(prev);
+    if(paths.empty() || !attrCache) return;
+
+    prefetchTask = ioExecutor->submit({}, [this, paths, cache = attrCache](IoTask& task) -> IoTask::Result {
+        for(const auto& path : paths)
+        {
+            if(task.isCancelled()) return {};
+            // 每个对象单独拿锁，选中项变了以后新的显示任务不用等所有预读完
+            H5Lock lock(hdf5Mutex());
+            if(!file_ptr) return {};
+            try {
+                std::shared_ptr<DataView> view;
+                handlePath(
+                    *file_ptr,
+                    path,
+                    [&](const HighFive::File& f){ cache->rows(f.getId()); },
+                    [&](const HighFive::DataSet& d) {
+                        cache->rows(d.getId());
+                        view = loadData(d);
+                        // 第一块进了Pager和ChunkCache，显示时不用再读
+                        if(view && view->pager->pageCount() > 0) view->pager->getCell(0, 0, 0);
+                    },
+                    [&](const HighFive::Group& g){ cache->rows(g.getId()); },
+                    [](){}
+                );
+                if(view) task.post([this, path, view](){ storePrefetched(path, view); });
+            }
+            catch(const HighFive::Exception&) {
+                // 预读失败不用管，真正显示时会再报错
+            }
+        }
+        return {};
+    }, this);
+}
+
+void MainWindow::prefetchPage(size_t idx)
+{
+    if(pagePrefetchTask) pagePrefetchTask->cancel();
+    if(!pagerPtr || idx >= pagerPtr->pageCount()) return;
+    pagePrefetchTask = ioExecutor->submit({}, [pager = pagerPtr, idx](IoTask& task) -> IoTask::Result {
+        if(task.isCancelled()) return {};
+        try {
+            pager->getCell(idx, 0, 0);
+        }
+        catch(const HighFive::Exception&) {
+        }
+        return {};
+    });
+}
+
+std::shared_ptr<MainWindow::DataView> MainWindow::takePrefetched(const QString& path)
+{
+    auto itr = std::find_if(prefetched.begin(), prefetched.end(), [&](const auto& p){ return p.first == path; });
+    if(itr == prefetched.end()) return nullptr;
+    auto view = itr->second;
+    prefetched.erase(itr);
+    return view;
+}
+
+void MainWindow::storePrefetched(const QString& path, std::shared_ptr<DataView> view)
+{
+    // 按缓存的块占的内存限制，不超过chunk缓存上限的1/4；刚预读的总是留着
+    auto budget = ChunkCache::instance().budget() / 4;
+    // 丢掉的视图里有数据集和Pager的句柄，要拿着锁释放
+    H5Lock lock(hdf5Mutex());
+    takePrefetched(path);
+    prefetched.emplace_front(path, std::move(view));
+    size_t bytes = 0;
+    auto itr = prefetched.begin();
+    for(; itr != prefetched.end(); ++itr)
+    {
+        auto& pager = itr->second->pager;
+        bytes += pager ? pager->tileBytes() : 0;
+        if(bytes > budget && itr != prefetched.begin()) break;
     }
+    prefetched.erase(itr, prefetched.end());
 }
 
 void MainWindow::clearItemViewer()
 {
+    if(prefetchTask) prefetchTask->cancel();
+    if(pagePrefetchTask) pagePrefetchTask->cancel();
+    if(viewerTask)
+    {
+        viewerTask->cancel();
+        viewerTask.reset();
+        ui->statusBar->clearMessage();
+    }
+    if(statsTask)
+    {
+        statsTask->cancel();
+        statsTask.reset();
+    }
+    ui->tableStats->clear();
+    ui->tableStats->setRowCount(0);
+    ui->plotView->clear();
+    // 数据集和Pager的句柄要拿着锁释放，交给后台线程，界面线程不用等正在读数据的任务
+    auto dataset = std::move(curr_dataset);
+    auto pager = std::move(pagerPtr);
     ui->tableAttr->clearContents();
+    viewerPath.clear();
+    viewerAttrs.reset();
     ui->tableView->setModel(nullptr);
-    tableModel.reset();
+    {
+        // 表格是界面线程的对象，不能交给后台线程；表格和正在读的块都拿着Pager，稀疏矩阵的Source里有数据集，拿着锁释放
+        H5Lock lock(hdf5Mutex());
+        tableModel.reset();
+        matModel.reset();
+    }
     ui->labelData->setText("");
-    ui->cbxDataPages->clear();
-    curr_dataset.reset();
-    pagerPtr.reset();
+    for(auto spin : pageSpins) delete spin;
+    pageSpins.clear();
+    ui->edtPageSlice->clear();
+    ui->edtPageSlice->setEnabled(false);
+    menuFields->clear();
+    ui->btnFields->setVisible(false);
+    curr_stats_kernel = {};
+    if(dataset || pager)
+    {
+        ioExecutor->submit({}, [dataset = std::move(dataset), pager = std::move(pager)](IoTask&) mutable -> IoTask::Result {
+            H5Lock lock(hdf5Mutex());
+            pager.reset();
+            dataset.reset();
+            return {};
+        });
+    }
 }
 
-QStandardItem* MainWindow::createTableItem(const void* data, HighFive::DataTypeClass class_type, size_t size, HighFive::CompoundType* compType)
+QString MainWindow::getCellString(const void* data, HighFive::DataTypeClass class_type, size_t size, const std::vector<Pager::Member>* members, std::string* ref_path)
 {   
     QString str;
     switch(class_type)
     {
     case HighFive::DataTypeClass::Reference:
-        if(size == sizeof(hobj_ref_t)) {
-            auto href = (hobj_ref_t*)data;
-            if (hid_t res = H5Rdereference(file_ptr->getId(), H5P_DEFAULT, H5R_OBJECT, href); res >= 0) {
-                MyTableRefItem *item = new MyTableRefItem();
-                MyObj obj(res);
-                auto obj_type = obj.getType();
-                if(HighFive::ObjectType::Dataset == obj_type)
-                {
-                    auto& ds = reinterpret_cast<const HighFive::DataSet&>(obj);  // 不是的话强制转换 //ref.dereference<HighFive::DataSet>(*file_ptr);
-                    item->path = ds.getPath();
-                    str = getShortString(ds);
-                }
-                else
-                {
-                    auto& grp = reinterpret_cast<const HighFive::Group&>(obj);
-                    item->path = grp.getPath();
-                    str = QString::fromStdString(item->path);
-                } 
-                item->setText(str);
-                item->type = obj_type;
-                return item;
+        if(size == sizeof(hobj_ref_t) && refResolver) {
+            // 预览还没准备好时先显示路径
+            auto info = refResolver->resolve(*(const hobj_ref_t*)data);
+            if(!info.path.empty()) {
+                str = info.has_preview ? info.preview : QString::fromStdString(info.path);
+                if(ref_path) *ref_path = info.path;
             }
         }
         break;
     case HighFive::DataTypeClass::Compound:
-        if(compType!=nullptr) {
+        if(members!=nullptr) {
             QStringList sl;
-            for(auto& m : compType->getMembers()) {
+            for(auto& m : *members) {
                 auto sub_size = m.base_type.getSize();
                 if(m.offset + sub_size <= size) {
-                    sl.append(getDisplayString((const char*)data + m.offset, m.base_type.getClass(), m.base_type.getSize())); 
+                    sl.append(getDisplayString((const char*)data + m.offset, m.base_type)); 
                 } else {
                     sl.append("?");
                 }
@@ -219,7 +658,53 @@ QStandardItem* MainWindow::createTableItem(const void* data, HighFive::DataTypeC
         str = getDisplayString(data, class_type, size);
         break;
     }
-    return new QStandardItem(str);
+    return str;
+}
+
+DataTableModel::CellFormatter MainWindow::makeFormatter(const HighFive::DataType& type)
+{
+    if(auto kernel = selectKernel(type))
+    {
+        return [kernel](const void* data, std::string*){ return formatCell(kernel, data); };
+    }
+    if(auto vlen = selectVlenFormat(type))
+    {
+        // 直接读Pager块里HDF5分配的内容，块释放前一直有效
+        return [vlen](const void* data, std::string*){ return formatVlen(data, vlen); };
+    }
+    auto class_type = type.getClass();
+    auto size = type.getSize();
+    if(class_type == HighFive::DataTypeClass::Compound)
+    {
+        return makeFormatter(HighFive::CompoundType(HighFive::DataType(type)).getMembers(), size);
+    }
+    // 引用的解析自己拿锁
+    return [this, class_type, size](const void* data, std::string* ref_path){
+        return getCellString(data, class_type, size, nullptr, ref_path);
+    };
+}
+
+DataTableModel::CellFormatter MainWindow::makeFormatter(const std::vector<Pager::Member>& members, size_t size)
+{
+    struct Field
+    {
+        size_t offset;
+        size_t size;
+        DataTableModel::CellFormatter formatter;
+    };
+    auto fields = std::make_shared<std::vector<Field>>();
+    for(auto& m : members)
+    {
+        fields->push_back({m.offset, m.base_type.getSize(), makeFormatter(m.base_type)});
+    }
+    return [fields, size](const void* data, std::string*){
+        QStringList sl;
+        for(auto& f : *fields)
+        {
+            sl.append(f.offset + f.size <= size ? f.formatter((const char*)data + f.offset, nullptr) : QString("?"));
+        }
+        return "{"+sl.join(',')+"}";
+    };
 }
 
 void MainWindow::updateUI()
@@ -227,57 +712,127 @@ void MainWindow::updateUI()
     ui->actionBack->setEnabled(!back_paths.empty());
     ui->actionForward->setEnabled(!forward_paths.empty());
 
-    auto tableData = dynamic_cast<QStandardItemModel*>(ui->tableView->model());
+    auto tableData = dynamic_cast<DataTableModel*>(ui->tableView->model());
     ui->actionCopy->setEnabled( tableData && tableData->rowCount() * tableData->columnCount() > 0);
+    ui->actionSave->setEnabled(ui->actionCopy->isEnabled());
+    ui->actionStats->setEnabled(curr_dataset && curr_stats_kernel);
+    ui->actionPlot->setEnabled(ui->actionStats->isEnabled() && pagerPtr && pagerPtr->pageCount() > 0);
+}
+
+void MainWindow::showStats(const DataStats& stats, size_t done, size_t total)
+{
+    auto number = [](double v){ return QString::number(v, 'g', 10); };
+    QVector<QPair<QString, QString>> rows{
+        {tr("Count"), QString::number(stats.count)},
+        {tr("NaN"), QString::number(stats.nan_count)},
+        {tr("Min"), stats.count ? number(stats.min) : QString()},
+        {tr("Max"), stats.count ? number(stats.max) : QString()},
+        {tr("Mean"), stats.count ? number(stats.mean) : QString()},
+        {tr("Std"), stats.count > 1 ? number(stats.stddev()) : QString()},
+    };
+    auto table = ui->tableStats;
+    table->clear();
+    table->setColumnCount(2);
+    table->setHorizontalHeaderLabels({tr("Statistic"), done < total ? tr("Value (%1%)").arg(done * 100 / total) : tr("Value")});
+    table->setRowCount(rows.size());
+    for(int i=0; i<rows.size(); i++)
+    {
+        table->setItem(i, 0, new QTableWidgetItem(rows[i].first));
+        table->setItem(i, 1, new QTableWidgetItem(rows[i].second));
+    }
+}
+
+void MainWindow::on_actionStats_triggered()
+{
+    if(!curr_dataset || !curr_stats_kernel) return;
+    if(statsTask) statsTask->cancel();
+
+    // 边算边显示到目前为止的结果，选中别的节点时取消
+    std::shared_ptr<HighFive::DataSet> dataset;
+    {
+        H5Lock lock(hdf5Mutex());
+        dataset = std::make_shared<HighFive::DataSet>(*curr_dataset);
+    }
+    statsTask = ioExecutor->submit(tr("Statistics"), [this, dataset](IoTask& task) -> IoTask::Result {
+        QElapsedTimer timer;
+        timer.start();
+        auto stats = computeStats(*dataset, [&](const DataStats& partial, size_t done, size_t total){
+            task.setProgress(done, total);
+            if(timer.elapsed() > 200 && done < total)
+            {
+                timer.restart();
+                task.post([this, partial, done, total](){ showStats(partial, done, total); });
+            }
+            return !task.isCancelled();
+        });
+        if(!stats) return {};
+        return [this, stats](){ showStats(*stats, 1, 1); };
+    }, this);
 }
 
 QString MainWindow::getShortString(const HighFive::DataSet& dataset)
 {
-    const static std::string name = "MATLAB_class";
     auto data_type = dataset.getDataType();
     auto class_type = data_type.getClass();
     auto size = data_type.getSize();
     auto eleCount = dataset.getElementCount();
     auto stsize = size * eleCount;
-    std::string mat_class;
-    if(dataset.hasAttribute(name))
-    {
-        auto attr = dataset.getAttribute(name);
-        auto stsize = attr.getStorageSize();
-        std::string buff(stsize, 0);
-        attr.read(buff.data(), attr.getDataType());
-        mat_class = buff;
-    }
+    auto mat_class = readMatlabClass(dataset);
 
-    std::unique_ptr<HighFive::CompoundType> compType;
+    std::vector<Pager::Member> members;
     if(class_type == HighFive::DataTypeClass::Compound)
     {
-        compType = std::make_unique<HighFive::CompoundType>(dataset.getDataType());
+        members = HighFive::CompoundType(dataset.getDataType()).getMembers();
     }
 
     if(class_type == HighFive::DataTypeClass::Integer && mat_class=="char")
     {
-        if(size == 0) return {};
-        std::vector<uint8_t> buff(stsize);
-        dataset.read(buff.data(), data_type);
-        std::wstring str(eleCount+1, 0);
-        for(size_t i=0; i<eleCount; i++)
+        // 很长的字符串只读前面一段；HDF5的最后一维是MATLAB的行
+        constexpr size_t MAX_CHAR_COLS = 4096;
+        if(size == 0 || eleCount == 0) return {};
+        auto dims = dataset.getDimensions();
+        size_t rows = dims.size() >= 2 ? dims.back() : 1;
+        size_t cols = eleCount / std::max<size_t>(rows, 1);
+        std::vector<uint8_t> buff;
+        bool truncated = dims.size() <= 2 && cols > MAX_CHAR_COLS;
+        if(truncated)
         {
-            memcpy(&str[i], &buff[i*size], std::min(size, sizeof(str[i])));
+            buff.resize(MAX_CHAR_COLS * rows * size);
+            std::vector<size_t> offset(dims.size(), 0), count{MAX_CHAR_COLS};
+            if(dims.size() == 2) count.push_back(rows);
+            dataset.select(offset, count).read(buff.data(), data_type);
+            cols = MAX_CHAR_COLS;
         }
-        return QString::fromStdWString(str);
+        else
+        {
+            buff.resize(stsize);
+            dataset.read(buff.data(), data_type);
+        }
+        auto lines = decodeMatChar(buff.data(), cols * rows, size, rows);
+        if(truncated) std::for_each(lines.begin(), lines.end(), [](QString& s){ s += QString::fromUtf8("…"); });
+        return lines.join("; ");
     }
-    else if(mat_class == "cell" && eleCount < 3) // show little cell
+    // 变长数据读出来的指针指向HDF5分配的内存，格式化时直接读，完了整块一次释放
+    auto vlen = selectVlenFormat(data_type);
+    auto reclaim = [&](std::vector<uint8_t>& buff){
+        if(hasVlenData(data_type.getId())) H5Treclaim(data_type.getId(), dataset.getSpace().getId(), H5P_DEFAULT, buff.data());
+    };
+    if(mat_class == "cell" && eleCount < 3) // show little cell
     {
         if(size == 0) return {};
         std::vector<uint8_t> buff(stsize);
         dataset.read(buff.data(), data_type);
+        if(class_type == HighFive::DataTypeClass::Reference && size == sizeof(hobj_ref_t) && refResolver)
+        {
+            std::vector<hobj_ref_t> refs((const hobj_ref_t*)buff.data(), (const hobj_ref_t*)buff.data() + eleCount);
+            refResolver->resolvePreviews(refs, [this](const HighFive::DataSet& ds){ return getShortString(ds); });
+        }
         QStringList sl;
         for (size_t i = 0; i < eleCount; i++)
         {
-            std::unique_ptr<QStandardItem> s(createTableItem(&buff[i * size], class_type, size, compType.get()));
-            sl.append(s->text());
+            sl.append(vlen ? formatVlen(&buff[i * size], vlen) : getCellString(&buff[i * size], class_type, size, &members));
         }
+        reclaim(buff);
         return "["+sl.join(', ')+"]";
     }
     else if(eleCount == 1)
@@ -285,45 +840,30 @@ QString MainWindow::getShortString(const HighFive::DataSet& dataset)
         if(size == 0) return {};
         std::vector<uint8_t> buff(stsize);
         dataset.read(buff.data(), data_type);
-        std::unique_ptr<QStandardItem> s(createTableItem(&buff[0], class_type, size, compType.get()));
-        return s->text();
+        if(auto kernel = selectMatKernel(data_type, mat_class))
+        {
+            return formatCell(kernel, buff.data());
+        }
+        auto str = vlen ? formatVlen(buff.data(), vlen) : getCellString(&buff[0], class_type, size, &members);
+        reclaim(buff);
+        return str;
     }
     return QString::fromStdString(dataset.getPath());
 }
 
-void MainWindow::showData(const HighFive::DataSet& dataset)
+std::shared_ptr<MainWindow::DataView> MainWindow::loadData(const HighFive::DataSet& dataset)
 {
-    pagerPtr.reset();
-    curr_dataset.reset();
-    auto table = ui->tableView;
-    auto text = ui->labelData;
-    auto pages = ui->cbxDataPages;
-    pages->clear();
-    table->setModel(nullptr);
-    text->setText("");
     auto dims = dataset.getDimensions();
     auto data_type = dataset.getDataType();
     auto class_type = data_type.getClass();
     auto size = data_type.getSize();
-    auto eleCount = dataset.getElementCount();
-    auto stsize = size * eleCount;
-    if(size == 0) return;
-
-    std::vector<uint8_t> buff(stsize);
-    dataset.read(buff.data(), data_type);
+    if(size == 0) return nullptr;
 
-    curr_dataset = std::make_unique<HighFive::DataSet>(dataset);
-    pagerPtr = std::make_unique<Pager>(std::move(buff), dims, size);
-    for (size_t i = 0, c = std::min<>(pagerPtr->pageCount(), 100ull); i < c; i++)
-    {
-        auto hidim = pagerPtr->getHiDimByPage(i);
-        QStringList sl;
-        std::transform(
-            hidim.rbegin(), hidim.rend(), std::back_inserter(sl),
-            [](auto d){ return QString::number(d + 1); });
-        QString pageName = "[:,:,"+sl.join(',')+"]";
-        ui->cbxDataPages->addItem(pageName, i);
-    }
+    // 不再读取整个数据集，Pager只在换页时读取该页
+    auto view = std::make_shared<DataView>();
+    view->dataset = std::make_shared<HighFive::DataSet>(dataset);
+    view->pager = std::make_shared<Pager>(dataset, dims, size, viewSlice({}, dims.size(), matlabOrder));
+    view->stats_kernel = selectStatsKernel(data_type);
 
     if(class_type == HighFive::DataTypeClass::Compound)
     {
@@ -334,52 +874,423 @@ void MainWindow::showData(const HighFive::DataSet& dataset)
         {
             sl.append(QString::fromStdString(m.name));
         }
-        text->setText( "Compound: " + sl.join(';') );
+        view->label = "Compound: " + sl.join(';');
+    }
+    else
+    {
+        view->label = getShortString(dataset);
+    }
+    return view;
+}
+
+std::shared_ptr<MainWindow::DataView> MainWindow::loadMatGroup(const HighFive::Group& group)
+{
+    // 稀疏矩阵和struct不是普通的组，显示成表格
+    if(auto sparse = SparseTableModel::load(group))
+    {
+        auto view = std::make_shared<DataView>();
+        view->sparse = sparse;
+        auto cols = sparse->jc.size() - 1;
+        view->label = tr("Sparse %1: %2×%3, %4 nonzeros").arg(QString::fromStdString(readMatlabClass(group)))
+            .arg(sparse->rows).arg(cols).arg(sparse->jc.back());
+        return view;
+    }
+    if(auto fields = StructTableModel::load(group, [this](const HighFive::DataSet& ds){ return getShortString(ds); }))
+    {
+        auto view = std::make_shared<DataView>();
+        view->fields = fields;
+        size_t count = 1;
+        for(auto& f : *fields)
+        {
+            if(!f.refs.empty()) count = f.refs.size();
+        }
+        view->label = tr("Struct: %1 element(s), %2 field(s)").arg(count).arg(fields->size());
+        return view;
+    }
+    return nullptr;
+}
+
+void MainWindow::showMatView(const DataView& view)
+{
+    ui->labelData->setText(view.label);
+    if(view.sparse)
+    {
+        matModel = std::make_unique<SparseTableModel>(view.sparse, ioExecutor.get());
     }
     else
     {
-        text->setText(getShortString(*curr_dataset));
+        auto model = std::make_unique<StructTableModel>(view.fields, refResolver, ioExecutor.get());
+        // struct数组先显示引用的路径，前面几行的预览在后台准备好以后再刷新
+        constexpr size_t PREVIEW_ROWS = 256;
+        auto refs = model->refs(PREVIEW_ROWS);
+        if(!refs.empty() && refResolver)
+        {
+            auto raw = model.get();
+            viewerTask = ioExecutor->submit({}, [this, raw, refs, resolver = refResolver](IoTask& task) -> IoTask::Result {
+                // resolvePreviews每个预览单独拿锁，界面线程不用等整批做完
+                resolver->resolvePreviews(refs, [this](const HighFive::DataSet& ds){ return getShortString(ds); }, &task);
+                return [this, raw](){
+                    if(matModel.get() == raw) raw->refresh();
+                };
+            }, this);
+        }
+        matModel = std::move(model);
+    }
+    ui->tableView->setModel(matModel.get());
+    updateUI();
+}
+
+void MainWindow::showData(const DataView& view)
+{
+    if(view.sparse || view.fields)
+    {
+        showMatView(view);
+        return;
     }
+    curr_dataset = view.dataset;
+    curr_stats_kernel = view.stats_kernel;
+    pagerPtr = view.pager;
+    initPageSpins();
+    initFieldsMenu();
+
+    ui->labelData->setText(view.label);
 
     showPage(0);
 }
 
-void MainWindow::showPage(int idx)
+void MainWindow::initPageSpins()
+{
+    // 不再列出所有页，每个高维度一个输入框，只读取选中的那一页
+    for(auto spin : pageSpins) delete spin;
+    pageSpins.clear();
+    auto& hiDims = pagerPtr->hiDims();
+    auto& axes = pagerPtr->pageAxes();
+    auto rank = pagerPtr->dims().size();
+    for(size_t i=hiDims.size(); i>0; i--)
+    {
+        auto spin = new QSpinBox(ui->frame);
+        spin->setRange(1, (int)std::min<size_t>(hiDims[i-1], INT_MAX));
+        spin->setKeyboardTracking(false);
+        spin->setToolTip(tr("Dimension %1 of %2").arg(rank - axes[i-1]).arg(rank));
+        connect(spin, SIGNAL(valueChanged(int)), this, SLOT(onPageSpinChanged()));
+        ui->layoutPages->insertWidget((int)pageSpins.size(), spin);
+        pageSpins.push_back(spin);
+    }
+    ui->edtPageSlice->setEnabled(rank > 0);
+}
+
+void MainWindow::initFieldsMenu()
+{
+    // 只有compound数据集才能选成员，默认读取所有成员
+    menuFields->clear();
+    auto& members = pagerPtr->members();
+    ui->btnFields->setVisible(!members.empty());
+    if(members.empty()) return;
+    menuFields->addAction(actionSplitMembers);
+    menuFields->addSeparator();
+    auto& fields = pagerPtr->fields();
+    std::vector<std::string> names;
+    {
+        H5Lock lock(hdf5Mutex());
+        for(auto& m : HighFive::CompoundType(curr_dataset->getDataType()).getMembers()) names.push_back(m.name);
+    }
+    for(auto& name : names)
+    {
+        auto action = menuFields->addAction(QString::fromStdString(name));
+        action->setCheckable(true);
+        action->setChecked(fields.empty() || std::find(fields.begin(), fields.end(), name) != fields.end());
+    }
+}
+
+void MainWindow::onFieldsTriggered(QAction* action)
+{
+    if(!pagerPtr || !curr_dataset || !tableModel) return;
+    auto page = tableModel->page();
+    if(action == actionSplitMembers)
+    {
+        showPage(page);
+        return;
+    }
+
+    std::vector<std::string> fields;
+    bool all = true;
+    for(auto a : menuFields->actions())
+    {
+        if(!a->isCheckable() || a == actionSplitMembers) continue;
+        if(a->isChecked()) fields.push_back(a->text().toStdString());
+        else all = false;
+    }
+    if(fields.empty())
+    {
+        // 至少留一个成员
+        action->setChecked(true);
+        return;
+    }
+    if(all) fields.clear();
+
+    // 只读选中的成员，换一个Pager；页、行列维度不变
+    try {
+        H5Lock lock(hdf5Mutex());
+        pagerPtr = std::make_shared<Pager>(*curr_dataset, pagerPtr->dims(), curr_dataset->getDataType().getSize(), pagerPtr->slice(), std::move(fields));
+    }
+    catch(const HighFive::Exception& ex) {
+        ui->statusBar->showMessage(QString::fromLocal8Bit(ex.what()));
+        return;
+    }
+    showPage(page);
+}
+
+void MainWindow::onPageSpinChanged()
+{
+    if(!pagerPtr) return;
+    std::vector<size_t> hidim;
+    std::transform(pageSpins.rbegin(), pageSpins.rend(), std::back_inserter(hidim),
+        [](auto spin){ return (size_t)spin->value() - 1; });
+    auto idx = pagerPtr->getPageByHiDim(hidim);
+    if(idx != SIZE_MAX) showPage(idx);
+}
+
+void MainWindow::on_edtPageSlice_returnPressed()
 {
-    if(idx < 0) return;
-    auto table = ui->tableView;
-    table->setModel(nullptr);
     if(!pagerPtr || !curr_dataset) return;
-    auto buff = pagerPtr->getPageData(idx);
-    auto row = pagerPtr->rowCount();
-    auto col = pagerPtr->columnCount();
-    auto size = pagerPtr->dataSize();
-    auto eleCount = buff.size() / size;
+    PageSlice slice;
+    std::vector<size_t> hidim;
+    if(!parsePageSlice(ui->edtPageSlice->text(), slice, hidim))
+    {
+        ui->statusBar->showMessage(tr("Invalid page slice: %1").arg(ui->edtPageSlice->text()));
+        if(tableModel) updatePageSlice(tableModel->page());
+        return;
+    }
+    slice = viewSlice(slice, pagerPtr->dims().size(), matlabOrder);
+    if(slice != pagerPtr->slice())
+    {
+        // 换了行、列维度或者步长，重新建一个Pager，已经解压的chunk还在ChunkCache里
+        try {
+            H5Lock lock(hdf5Mutex());
+            pagerPtr = std::make_shared<Pager>(*curr_dataset, pagerPtr->dims(), curr_dataset->getDataType().getSize(), slice, pagerPtr->fields());
+        }
+        catch(const HighFive::Exception& ex) {
+            ui->statusBar->showMessage(QString::fromLocal8Bit(ex.what()));
+            return;
+        }
+        initPageSpins();
+    }
+    auto idx = pagerPtr->getPageByHiDim(hidim);
+    if(idx != SIZE_MAX) showPage(idx);
+}
 
-    tableModel = std::make_unique<QStandardItemModel>();
+bool MainWindow::parsePageSlice(const QString& text, PageSlice& slice, std::vector<size_t>& hidim) const
+{
+    // 和显示的一样按MATLAB的顺序，下标从1开始；表格的维度写":"，"::k"表示每k个取一个
+    // 靠前的":"是列，靠后的是行（MATLAB顺序时反过来，和MATLAB的A(:,:,k)一样）；只写高维度的下标时保持现在的行、列维度
+    auto body = text.trimmed();
+    if(body.startsWith('[')) body.remove(0, 1);
+    if(body.endsWith(']')) body.chop(1);
+    auto parts = body.trimmed().isEmpty() ? QStringList{} : body.split(',');
+    auto& dims = pagerPtr->dims();
+    auto rank = dims.size();
+    slice = pagerPtr->slice();
+    hidim.clear();
 
-    auto data_type = curr_dataset->getDataType();
-    auto class_type = data_type.getClass();
-    std::unique_ptr<HighFive::CompoundType> compType;
-    if(class_type == HighFive::DataTypeClass::Compound)
+    auto& hi_dims = pagerPtr->hiDims();
+    if((size_t)parts.size() == hi_dims.size())
     {
-        compType = std::make_unique<HighFive::CompoundType>(std::move(data_type));
+        // 显示的顺序和高维度相反，第几个push进去的就是第几个高维度
+        for(auto itr = parts.rbegin(); itr != parts.rend(); ++itr)
+        {
+            bool ok = false;
+            auto value = itr->trimmed().toULongLong(&ok);
+            if(!ok || value == 0 || value > hi_dims[hidim.size()]) return false;
+            hidim.push_back((size_t)value - 1);
+        }
+        return true;
     }
+    if((size_t)parts.size() != rank) return false;
 
-    for(size_t r=0; r<row; r++)
+    std::vector<int> axes;
+    std::vector<size_t> steps;
+    std::vector<size_t> index(rank, 0);
+    for(size_t i=0; i<rank; i++)
     {
-        QList<QStandardItem*> rowItems;
-        for(size_t c=0; c<col; c++)
+        auto axis = rank - 1 - i;
+        auto token = parts[(int)i].trimmed();
+        bool ok = false;
+        if(token.startsWith(':'))
         {
-            size_t idx = r*col+c;
-            auto s = createTableItem(&buff[idx * size], class_type, size, compType.get());
-            rowItems.append(s);
+            size_t step = 1;
+            if(token.size() > 1)
+            {
+                if(!token.startsWith("::")) return false;
+                step = (size_t)token.mid(2).toULongLong(&ok);
+                if(!ok || step == 0) return false;
+            }
+            axes.push_back((int)axis);
+            steps.push_back(step);
+            continue;
         }
-        tableModel->appendRow(rowItems);
+        auto value = token.toULongLong(&ok);
+        if(!ok || value == 0 || value > dims[axis]) return false;
+        index[axis] = (size_t)value - 1;
+    }
+    if(axes.size() != std::min<size_t>(rank, 2)) return false;
+
+    slice.colAxis = axes[0];
+    slice.colStep = steps[0];
+    slice.rowAxis = axes.size() > 1 ? axes[1] : -1;
+    slice.rowStep = axes.size() > 1 ? steps[1] : 1;
+    for(size_t axis=0; axis<rank; axis++)
+    {
+        if((int)axis != slice.rowAxis && (int)axis != slice.colAxis) hidim.push_back(index[axis]);
+    }
+    return true;
+}
+
+void MainWindow::updatePageSlice(size_t idx)
+{
+    auto hidim = pagerPtr->getHiDimByPage(idx);
+    auto& slice = pagerPtr->slice();
+    auto& axes = pagerPtr->pageAxes();
+    auto colon = [](size_t step){ return step == 1 ? QString(":") : "::" + QString::number(step); };
+    QStringList sl;
+    for(size_t i=pagerPtr->dims().size(); i>0; i--)
+    {
+        int axis = (int)i - 1;
+        if(axis == slice.colAxis) sl.append(colon(slice.colStep));
+        else if(axis == slice.rowAxis) sl.append(colon(slice.rowStep));
+        else sl.append(QString::number(hidim[std::find(axes.begin(), axes.end(), (size_t)axis) - axes.begin()] + 1));
+    }
+    ui->edtPageSlice->setText("["+sl.join(',')+"]");
+
+    for(size_t i=0; i<pageSpins.size(); i++)
+    {
+        QSignalBlocker blocker(pageSpins[i]);
+        pageSpins[i]->setValue((int)hidim[hidim.size() - 1 - i] + 1);
+    }
+}
+
+void MainWindow::showPage(size_t idx)
+{
+    if(pagerPtr && idx < pagerPtr->pageCount()) updatePageSlice(idx);
+    auto table = ui->tableView;
+    table->setModel(nullptr);
+    {
+        // 表格拿着Pager，要拿着锁释放
+        H5Lock lock(hdf5Mutex());
+        tableModel.reset();
+    }
+    if(!pagerPtr || !curr_dataset) return;
+    auto size = pagerPtr->dataSize();
+
+    // 只有读类型、选格式化函数时拿锁，建表格和界面不用
+    HighFive::DataTypeClass class_type;
+    CellKernel kernel;
+    DataTableModel::CellFormatter formatter;
+    std::vector<DataTableModel::MemberColumn> columns;
+    {
+        H5Lock lock(hdf5Mutex());
+        auto data_type = curr_dataset->getDataType();
+        class_type = data_type.getClass();
+        kernel = selectMatKernel(data_type, readMatlabClass(*curr_dataset)); // 数值类型每页只选一次格式化函数
+
+        if(kernel)
+        {
+            formatter = [kernel](const void* data, std::string*){ return formatCell(kernel, data); };
+        }
+        else if(class_type == HighFive::DataTypeClass::Compound)
+        {
+            // 成员的偏移按Pager读出来的元素，只读部分成员时和文件里的类型不一样
+            formatter = makeFormatter(pagerPtr->members(), size);
+        }
+        else
+        {
+            formatter = makeFormatter(data_type);
+        }
+
+        // 每个成员一列，格式化时直接指向元素里的成员
+        if(actionSplitMembers->isChecked())
+        {
+            for(auto& m : pagerPtr->members())
+            {
+                columns.push_back({QString::fromStdString(m.name), m.offset, makeFormatter(m.base_type)});
+            }
+        }
+    }
+
+    // 单元格在显示时才在后台读取和格式化
+    tableModel = std::make_unique<DataTableModel>(pagerPtr, idx, formatter, ioExecutor.get());
+    if(kernel) tableModel->setKernel(kernel);
+    if(!columns.empty()) tableModel->setMembers(std::move(columns));
+    if(class_type == HighFive::DataTypeClass::Reference && size == sizeof(hobj_ref_t) && refResolver)
+    {
+        // 引用按块批量解析：先解析路径显示出来，再补上预览
+        tableModel->setBlockPrepare([this, resolver = refResolver](const std::vector<const void*>& cells, bool full, IoTask& task){
+            std::vector<hobj_ref_t> refs;
+            for(auto p : cells)
+            {
+                if(p) refs.push_back(*(const hobj_ref_t*)p);
+            }
+            if(!full)
+            {
+                resolver->resolvePaths(refs);
+                return true;
+            }
+            resolver->resolvePreviews(refs, [this](const HighFive::DataSet& ds){ return getShortString(ds); }, &task);
+            return false;
+        });
     }
 
     table->setModel(tableModel.get());
     updateUI();
+    showPlot();
+    prefetchPage(idx + 1);
+}
+
+void MainWindow::showPlot()
+{
+    // 数值数据集才能画图，其它类型还是显示表格
+    bool plot = ui->actionPlot->isChecked() && ui->actionPlot->isEnabled() && tableModel;
+    ui->tableView->setVisible(!plot);
+    ui->plotView->setVisible(plot);
+    if(plot)
+    {
+        ui->plotView->setPage(pagerPtr, tableModel->page(), curr_stats_kernel);
+    }
+    else
+    {
+        ui->plotView->clear();
+    }
+}
+
+void MainWindow::on_actionPlot_toggled(bool)
+{
+    showPlot();
+}
+
+void MainWindow::on_actionMatlabOrder_toggled(bool checked)
+{
+    matlabOrder = checked;
+    // 预读的Pager还是原来的顺序
+    if(prefetchTask) prefetchTask->cancel();
+    if(pagePrefetchTask) pagePrefetchTask->cancel();
+    {
+        H5Lock lock(hdf5Mutex());
+        prefetched.clear();
+    }
+    if(!pagerPtr || !curr_dataset || !tableModel) return;
+    auto slice = viewSlice(pagerPtr->slice(), pagerPtr->dims().size(), matlabOrder);
+    if(slice == pagerPtr->slice()) return;
+
+    // 高维度不变，还是同一页；已经解压的chunk还在ChunkCache里
+    auto page = tableModel->page();
+    try {
+        H5Lock lock(hdf5Mutex());
+        pagerPtr = std::make_shared<Pager>(*curr_dataset, pagerPtr->dims(), curr_dataset->getDataType().getSize(), slice, pagerPtr->fields());
+    }
+    catch(const HighFive::Exception& ex) {
+        ui->statusBar->showMessage(QString::fromLocal8Bit(ex.what()));
+        return;
+    }
+    showPage(page);
 }
 
 void MainWindow::dropEvent(QDropEvent *event)
@@ -389,11 +1300,10 @@ void MainWindow::dropEvent(QDropEvent *event)
         return;
     }
 
-    QString filePath = urls.first().toLocalFile();
-    curr_dataset.reset();
-    pagerPtr.reset();
-    file_ptr = std::make_unique<HighFive::File>(filePath.toStdString());
-    gotoPath("", GotoMode::Init);
+    for(const auto& url : urls)
+    {
+        if(url.isLocalFile()) openFile(url.toLocalFile());
+    }
 }
 
 void MainWindow::dragEnterEvent(QDragEnterEvent *event)
@@ -407,35 +1317,116 @@ void MainWindow::showItemViewer(const QString& path)
 {
     clearItemViewer();
     if(!file_ptr) return;
-    try {
-        handlePath(
-            *file_ptr,
-            path,
-            [this](const HighFive::File& f){ ::showAttrib(ui->tableAttr, f);},
-            [this](const HighFive::DataSet& d) {
-                ::showAttrib(ui->tableAttr,d);
-                showData(d);
-            },
-            [this](const HighFive::Group& g){ ::showAttrib(ui->tableAttr, g);},
-            [](){}
-        );
-    }
-    catch(const HighFive::Exception& ex) {
-        QMessageBox::critical(this, tr("HDF5 PAD"),
-                               ex.what(),
-                               QMessageBox::Ok);
-    }
+    // 属性和数据集在后台读取，选中项改变时旧任务被取消，结果不会再显示
+    auto title = tr("Loading %1").arg(path);
+    ui->statusBar->showMessage(title);
+    viewerPath = path;
+    auto cached = takePrefetched(path);
+    viewerTask = ioExecutor->submit(title, [this, path, cache = attrCache, cached](IoTask& task) -> IoTask::Result {
+        // 属性和数据分两步读，每步单独拿锁，中间检查是否已经取消
+        std::optional<HighFive::DataSet> dataset;
+        std::optional<HighFive::Group> group;
+        auto release = [&](){
+            H5Lock lock(hdf5Mutex());
+            dataset.reset();
+            group.reset();
+        };
+        AttrCache::Rows attrs;
+        std::shared_ptr<DataView> view;
+        try {
+            {
+                H5Lock lock(hdf5Mutex());
+                if(!file_ptr || !cache || task.isCancelled()) return {};
+                handlePath(
+                    *file_ptr,
+                    path,
+                    [&](const HighFive::File& f){ attrs = cache->rows(f.getId());},
+                    [&](const HighFive::DataSet& d) {
+                        attrs = cache->rows(d.getId());
+                        if(!cached) dataset.emplace(d);
+                    },
+                    [&](const HighFive::Group& g){
+                        attrs = cache->rows(g.getId());
+                        group.emplace(g);
+                    },
+                    [](){}
+                );
+            }
+            if(task.isCancelled())
+            {
+                release();
+                return {};
+            }
+            if(cached)
+            {
+                view = cached;
+            }
+            else if(dataset || group)
+            {
+                H5Lock lock(hdf5Mutex());
+                view = dataset ? loadData(*dataset) : loadMatGroup(*group);
+            }
+        }
+        catch(...) {
+            release();
+            throw;
+        }
+        release();
+        return [this, attrs, view](){
+            viewerAttrs = attrs;
+            if(attrs) ::showAttrib(ui->tableAttr, *attrs);
+            if(view) showData(*view);
+        };
+    }, this);
 }
 
-void MainWindow::on_tableView_doubleClicked(const QModelIndex &index)
+void MainWindow::onTaskProgress(QString title, int percent)
 {
-    auto tableData = dynamic_cast<QStandardItemModel*>(ui->tableView->model());
-    if(!tableData) return;
+    ui->statusBar->showMessage(QString("%1 %2%").arg(title).arg(percent));
+}
 
-    auto item = tableData->item(index.row(), index.column());
-    auto myitem = dynamic_cast<MyTableRefItem*>(item);
-    if(myitem)
+void MainWindow::onTaskFinished(QString title)
+{
+    ui->statusBar->clearMessage();
+}
+
+void MainWindow::onTaskFailed(QString title, QString message)
+{
+    ui->statusBar->clearMessage();
+    QMessageBox::critical(this, tr("HDF5 PAD"),
+                           message,
+                           QMessageBox::Ok);
+}
+
+void MainWindow::on_tableAttr_cellDoubleClicked(int row, int)
+{
+    // 大的属性值这时才读，结果也放进缓存
+    if(!viewerAttrs || row < 0 || row >= (int)viewerAttrs->size() || !(*viewerAttrs)[row].lazy || !attrCache || !file_ptr) return;
+    auto path = viewerPath;
+    auto title = tr("Reading attribute %1").arg((*viewerAttrs)[row].name);
+    // 文件和缓存在提交时取得，任务运行前切换了标签页也不会读到别的文件
+    ioExecutor->submit(title, [this, path, row, file = file_ptr, cache = attrCache](IoTask& task) -> IoTask::Result {
+        H5Lock lock(hdf5Mutex());
+        if(task.isCancelled()) return {};
+        auto obj_path = path.isEmpty() ? QString("/") : path;
+        MyObj obj(H5Oopen(file->getId(), obj_path.toUtf8().constData(), H5P_DEFAULT));
+        if(!obj.isValid()) throw HighFive::ObjectException("Unable to open " + obj_path.toStdString());
+        auto attrs = cache->readValue(obj.getId(), row);
+        return [this, path, attrs, owner = cache.get()](){
+            if(path != viewerPath || owner != attrCache.get()) return;
+            viewerAttrs = attrs;
+            ::showAttrib(ui->tableAttr, *attrs);
+        };
+    }, this);
+}
+
+void MainWindow::on_tableView_doubleClicked(const QModelIndex &index)
+{
+    // 表格里的引用同步解析；struct的单元格用UserRole给出路径
+    auto tableData = dynamic_cast<DataTableModel*>(ui->tableView->model());
+    auto path = tableData ? tableData->cellRefPath(index.row(), index.column()) : index.data(Qt::UserRole).toString();
+    if(!path.isEmpty())
     {
-        gotoPath(QString::fromStdString(myitem->path), GotoMode::Normal);
+        gotoPath(path, GotoMode::Normal);
     }
 }
\ No newline at end of file
@@ -2,8 +2,17 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QStandardItemModel> 
 #include "pager.h"
+#include "datatablemodel.h"
+#include "treeloader.h"
+#include "ioexecutor.h"
+#include "refresolver.h"
+#include "metaindex.h"
+#include "pathsearch.h"
+#include "datastats.h"
+#include "filepool.h"
+#include "attrcache.h"
+#include "matfile.h"
 
 namespace Ui {
 class MainWindow;
@@ -23,38 +32,130 @@ public slots:
     void on_actionBack_triggered();
     void on_actionForward_triggered();
     void on_actionCopy_triggered();
+    void on_actionSave_triggered();
+    void on_actionStats_triggered();
+    void on_actionPlot_toggled(bool checked);
+    void on_actionMatlabOrder_toggled(bool checked);
     void on_btnGo_clicked();
     void on_btnUp_clicked();
     void on_tree_itemDoubleClicked(QTreeWidgetItem *item, int column);
     void on_tree_itemSelectionChanged();
     void on_tableView_doubleClicked(const QModelIndex &index);
-    void showPage(int idx);
+    void on_tableAttr_cellDoubleClicked(int row, int column);
+    void on_edtPageSlice_returnPressed();
+    void on_edtSearch_returnPressed();
+    void on_listSearch_itemActivated(QListWidgetItem *item);
     void dropEvent(QDropEvent *event) override;
     void dragEnterEvent(QDragEnterEvent *event) override;
+private slots:
+    void activateSession(int idx);
+    void closeSession(int idx);
+    void onPageSpinChanged();
+    void onFieldsTriggered(QAction* action);
+    void onTaskProgress(QString title, int percent);
+    void onTaskFinished(QString title);
+    void onTaskFailed(QString title, QString message);
 private:
     Ui::MainWindow *ui;
-    std::unique_ptr<HighFive::File> file_ptr;
+    std::shared_ptr<HighFive::File> file_ptr; // 当前标签页的文件，从filePool取得
+    std::shared_ptr<RefResolver> refResolver; // 跟file_ptr一起换
+    std::shared_ptr<const MetaIndex> metaIndex; // 跟file_ptr一起换，没有索引时为空
+    std::shared_ptr<AttrCache> attrCache; // 跟file_ptr一起换
     QString root_path;
     QStack<QString> back_paths;
     QStack<QString> forward_paths;
 
-    std::unique_ptr<HighFive::DataSet> curr_dataset;
-    std::unique_ptr<Pager> pagerPtr;
-    std::unique_ptr<QStandardItemModel> tableModel;
+    std::shared_ptr<HighFive::DataSet> curr_dataset;
+    std::shared_ptr<Pager> pagerPtr;
+    std::unique_ptr<DataTableModel> tableModel;
+    std::unique_ptr<QAbstractTableModel> matModel; // 稀疏矩阵、struct的表格
+    std::unique_ptr<TreeLoader> treeLoader; // 要在file_ptr之前析构
+    std::unique_ptr<IoExecutor> ioExecutor; // 要在file_ptr之前析构
+    std::shared_ptr<IoTask> viewerTask;
+    QString viewerPath; // 右边显示的对象
+    AttrCache::Rows viewerAttrs;
+    std::shared_ptr<IoTask> statsTask;
+    StatsKernel curr_stats_kernel; // curr_dataset是数值类型时才有，统计和预览图用
+    std::shared_ptr<const PathSearch> pathSearch; // 索引建好之后在后台建立
+    std::unique_ptr<FilePool> filePool;
+    QTabBar* tabFiles;
+
+    // 每个打开的文件一个标签页，切换时保存、恢复各自的状态
+    // 索引、搜索索引一直留着，切换回来时不用重建；文件句柄由filePool管理，被关掉时再打开
+    struct FileSession
+    {
+        QString fileName; // 绝对路径
+        QString root_path;
+        QStack<QString> back_paths;
+        QStack<QString> forward_paths;
+        std::shared_ptr<RefResolver> refResolver; // 引用着文件，filePool关闭文件时丢掉
+        std::shared_ptr<const MetaIndex> metaIndex;
+        std::shared_ptr<const PathSearch> pathSearch;
+        std::shared_ptr<AttrCache> attrCache; // 属性表按对象缓存，文件关掉也不用丢
+        std::shared_ptr<IoTask> indexTask; // 正在建索引或者搜索索引
+    };
+    std::vector<FileSession> sessions; // 和tabFiles的标签页一一对应
+    int curr_session{-1};
+    std::shared_ptr<IoTask> searchTask;
+    std::vector<QSpinBox*> pageSpins; // 每个高维度一个，按MATLAB的顺序从1开始
+    QMenu* menuFields; // compound的成员，勾选的才读取
+    QAction* actionSplitMembers; // 每个成员单独一列
+    std::atomic<bool> matlabOrder{false}; // 行、列按MATLAB的顺序，后台建Pager时也要看
+
+    // 后台读取好的数据集，在界面线程里显示
+    struct DataView
+    {
+        std::shared_ptr<HighFive::DataSet> dataset;
+        std::shared_ptr<Pager> pager;
+        QString label;
+        StatsKernel stats_kernel;
+        // MAT文件的稀疏矩阵和struct是组，有其中一个时不用上面的
+        std::shared_ptr<const SparseTableModel::Source> sparse;
+        std::shared_ptr<const std::vector<StructTableModel::Field>> fields;
+    };
+    // 方向键浏览时预读下面几项的属性和第一块数据，还没显示过的放在这里，最近的在前面
+    std::list<std::pair<QString, std::shared_ptr<DataView>>> prefetched;
+    std::shared_ptr<IoTask> prefetchTask;
+    std::shared_ptr<IoTask> pagePrefetchTask; // 预读下一页
 
 private:
     // back: root_path入forward_paths, back_paths出栈, 更新按钮状态
     // go: root_path入back_paths，forward_path清空, 更新按钮状态
     // forward: root_path入back_paths, forward_path出栈, 更新按钮状态
     enum class GotoMode { Init, Normal, Back, Forward };
+    void openFile(const QString& fileName); // 已经打开的文件切换到它的标签页
+    FileSession* findSession(const QString& fileName);
+    void saveSession();
+    void openIndex(FileSession& session);
+    void onIndexReady(const QString& fileName, std::shared_ptr<const MetaIndex> index);
+    void buildSearch(FileSession& session);
     void gotoPath(const QString& path, GotoMode mode);
     void initTree();
     void clearItemViewer();
     void showItemViewer(const QString& path);
-    void showData( const HighFive::DataSet& dataset);
+    void prefetchNeighbours(QTreeWidgetItem* item);
+    void prefetchPage(size_t idx);
+    std::shared_ptr<DataView> takePrefetched(const QString& path);
+    void storePrefetched(const QString& path, std::shared_ptr<DataView> view);
+    std::shared_ptr<DataView> loadData(const HighFive::DataSet& dataset);
+    std::shared_ptr<DataView> loadMatGroup(const HighFive::Group& group); // 不是稀疏矩阵或struct时返回空
+    void showData(const DataView& view);
+    void showMatView(const DataView& view);
+    void showPage(size_t idx); // 只读取选中的页，和总页数无关
+    void showPlot();
+    void initPageSpins();
+    void initFieldsMenu();
+    void updatePageSlice(size_t idx);
+    // 解析"[:,:,5000,3]"或者"[::100,:]"，得到行、列维度和高维度的下标，还要用viewSlice摆好
+    bool parsePageSlice(const QString& text, PageSlice& slice, std::vector<size_t>& hidim) const;
     QString getShortString(const HighFive::DataSet& dataset);
-    QStandardItem* createTableItem(const void* data, HighFive::DataTypeClass class_type, size_t size, HighFive::CompoundType* compType=nullptr);
+    QString getCellString(const void* data, HighFive::DataTypeClass class_type, size_t size, const std::vector<Pager::Member>* members=nullptr, std::string* ref_path=nullptr);
+    // 拿着锁按类型选好格式化函数（compound按成员递归），格式化单元格时不再调用HDF5
+    DataTableModel::CellFormatter makeFormatter(const HighFive::DataType& type);
+    DataTableModel::CellFormatter makeFormatter(const std::vector<Pager::Member>& members, size_t size); // compound，size是元素大小
     void updateUI();
+    void showStats(const DataStats& stats, size_t done, size_t total);
+    QVector<QRect> selectedRanges() const;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,319 @@
+#include "prefix.h"
+#include "matfile.h"
+#include "refresolver.h"
+#include "hdf5lock.h"
+#include "ioexecutor.h"
+
+namespace
+{
+    constexpr int COLUMN_CACHE_KB = 64 * 1024; // 稀疏矩阵缓存的列，大约64MB
+    constexpr int STRUCT_BLOCK_ROWS = 64; // struct数组每次在后台解析的行数
+
+    size_t formatLogical(const void* src, char* dst)
+    {
+        auto text = *(const uint8_t*)src ? "true" : "false";
+        auto len = strlen(text);
+        memcpy(dst, text, len);
+        return len;
+    }
+}
+
+CellKernel selectMatKernel(const HighFive::DataType& type, const std::string& mat_class)
+{
+    if(mat_class == "logical" && type.getClass() == HighFive::DataTypeClass::Integer && type.getSize() == 1)
+    {
+        return CellKernel{formatLogical, 1};
+    }
+    return selectKernel(type);
+}
+
+QStringList decodeMatChar(const void* data, size_t count, size_t size, size_t rows)
+{
+    QStringList lines;
+    rows = std::max<size_t>(rows, 1);
+    if(count == 0 || (size != 1 && size != 2)) return lines;
+    auto cols = count / rows;
+    if(rows == 1)
+    {
+        // MATLAB的char是UTF-16，整行一次转换
+        lines.append(size == 2 ? QString::fromUtf16((const ushort*)data, (int)cols) : QString::fromLatin1((const char*)data, (int)cols));
+        return lines;
+    }
+    std::vector<ushort> line(cols);
+    for(size_t r=0; r<rows; r++)
+    {
+        for(size_t c=0; c<cols; c++)
+        {
+            auto idx = c * rows + r;
+            line[c] = size == 2 ? ((const ushort*)data)[idx] : ((const uint8_t*)data)[idx];
+        }
+        lines.append(QString::fromUtf16(line.data(), (int)cols));
+    }
+    return lines;
+}
+
+std::shared_ptr<const SparseTableModel::Source> SparseTableModel::load(const HighFive::Group& group)
+{
+    const static std::string sparse_attr = "MATLAB_sparse";
+    if(!group.hasAttribute(sparse_attr) || !group.exist("jc")) return nullptr;
+    auto source = std::make_shared<Source>();
+    uint64_t rows = 0;
+    group.getAttribute(sparse_attr).read(&rows, HighFive::AtomicType<uint64_t>());
+    source->rows = (size_t)rows;
+
+    auto jc = group.getDataSet("jc");
+    source->jc.resize(jc.getElementCount());
+    jc.read(source->jc.data(), HighFive::AtomicType<uint64_t>());
+    if(source->jc.empty()) return nullptr;
+
+    // 全是0的稀疏矩阵没有data和ir
+    if(group.exist("data") && group.exist("ir"))
+    {
+        source->data = std::make_shared<HighFive::DataSet>(group.getDataSet("data"));
+        source->ir = std::make_shared<HighFive::DataSet>(group.getDataSet("ir"));
+        source->kernel = selectMatKernel(source->data->getDataType(), readMatlabClass(group));
+    }
+    return source;
+}
+
+SparseTableModel::SparseTableModel(std::shared_ptr<const Source> source, IoExecutor* executor, QObject *parent)
+: QAbstractTableModel(parent), _source(std::move(source)), _executor(executor), _columns(COLUMN_CACHE_KB)
+{
+}
+
+SparseTableModel::~SparseTableModel()
+{
+    for(auto& task : _pending)
+    {
+        task->cancel();
+    }
+}
+
+int SparseTableModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid()) return 0;
+    return (int)std::min<size_t>(_source->rows, INT_MAX);
+}
+
+int SparseTableModel::columnCount(const QModelIndex &parent) const
+{
+    if(parent.isValid()) return 0;
+    return (int)std::min<size_t>(_source->jc.size() - 1, INT_MAX);
+}
+
+std::shared_ptr<SparseTableModel::Column> SparseTableModel::readColumn(const Source& source, int col)
+{
+    auto c = std::make_shared<Column>();
+    auto begin = source.jc[col];
+    auto end = std::max(source.jc[col + 1], begin);
+    size_t n = end - begin;
+    if(n == 0 || !source.data) return c;
+
+    // 只读这一列的非零元素
+    H5Lock lock(hdf5Mutex());
+    try {
+        auto type = source.data->getDataType();
+        c->ir.resize(n);
+        c->values.resize(n * type.getSize());
+        std::vector<size_t> offset{(size_t)begin}, count{n};
+        source.ir->select(offset, count).read(c->ir.data(), HighFive::AtomicType<uint64_t>());
+        source.data->select(offset, count).read(c->values.data(), type);
+    }
+    catch(const HighFive::Exception&) {
+        c->ir.clear();
+        c->values.clear();
+    }
+    return c;
+}
+
+void SparseTableModel::insertColumn(int col, std::shared_ptr<Column> c) const
+{
+    auto n = c->ir.size();
+    auto size = n == 0 ? 0 : c->values.size() / n;
+    // 比整个缓存还大的列也要放得进去，不然显示不出来
+    _columns.insert(col, new Column(std::move(*c)), std::min(1 + (int)(n * (sizeof(uint64_t) + size) / 1024), COLUMN_CACHE_KB));
+}
+
+void SparseTableModel::applyColumn(int col, std::shared_ptr<Column> c)
+{
+    _pending.remove(col);
+    insertColumn(col, std::move(c));
+    if(rowCount() > 0) emit dataChanged(index(0, col), index(rowCount() - 1, col));
+}
+
+const SparseTableModel::Column* SparseTableModel::column(int col) const
+{
+    if(auto c = _columns.object(col)) return c;
+    if(!_executor)
+    {
+        insertColumn(col, readColumn(*_source, col));
+        return _columns.object(col);
+    }
+    if(_pending.contains(col)) return nullptr;
+
+    auto self = const_cast<SparseTableModel*>(this);
+    auto task = _executor->submit({}, [self, col, source = _source](IoTask& task) -> IoTask::Result {
+        if(task.isCancelled()) return {};
+        auto c = readColumn(*source, col);
+        // 在界面线程里执行，self已经由context检查过还活着
+        return [self, col, c](){ self->applyColumn(col, c); };
+    }, self);
+    _pending.insert(col, task);
+    return nullptr;
+}
+
+QVariant SparseTableModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || (role != Qt::DisplayRole && role != Qt::ForegroundRole)) return {};
+    auto c = column(index.column());
+    if(!c) return {};
+    auto itr = std::lower_bound(c->ir.begin(), c->ir.end(), (uint64_t)index.row());
+    bool zero = itr == c->ir.end() || *itr != (uint64_t)index.row();
+    if(role == Qt::ForegroundRole) return zero ? QVariant(QColor(Qt::gray)) : QVariant();
+    if(zero) return QString("0");
+    if(!_source->kernel) return QString("?");
+    auto size = c->values.size() / c->ir.size();
+    return formatCell(_source->kernel, c->values.data() + (itr - c->ir.begin()) * size);
+}
+
+std::shared_ptr<const std::vector<StructTableModel::Field>> StructTableModel::load(const HighFive::Group& group, const Preview& preview)
+{
+    if(readMatlabClass(group) != "struct") return nullptr;
+    // struct数组的字段是引用数组（没有MATLAB_class）；cell字段也是引用数组，但标着cell
+    auto fields = std::make_shared<std::vector<Field>>();
+    for(const auto& name : group.listObjectNames())
+    {
+        Field field;
+        field.name = QString::fromStdString(name);
+        field.path = QString::fromStdString(group.getPath() + "/" + name);
+        auto type = group.getObjectType(name);
+        if(type == HighFive::ObjectType::Dataset)
+        {
+            auto ds = group.getDataSet(name);
+            auto data_type = ds.getDataType();
+            auto mat_class = readMatlabClass(ds);
+            if(data_type.getClass() == HighFive::DataTypeClass::Reference && data_type.getSize() == sizeof(hobj_ref_t) && mat_class.empty())
+            {
+                field.refs.resize(ds.getElementCount());
+                ds.read(field.refs.data(), data_type);
+            }
+            else
+            {
+                field.text = preview(ds);
+            }
+        }
+        else if(type == HighFive::ObjectType::Group)
+        {
+            auto mat_class = readMatlabClass(group.getGroup(name));
+            field.text = "[" + QString::fromStdString(mat_class.empty() ? "group" : mat_class) + "]";
+        }
+        fields->push_back(std::move(field));
+    }
+    return fields;
+}
+
+StructTableModel::StructTableModel(std::shared_ptr<const std::vector<Field>> fields, std::shared_ptr<RefResolver> resolver, IoExecutor* executor, QObject *parent)
+: QAbstractTableModel(parent), _fields(std::move(fields)), _resolver(std::move(resolver)), _executor(executor)
+{
+    for(auto& f : *_fields) _rows = std::max(_rows, f.refs.size());
+}
+
+StructTableModel::~StructTableModel()
+{
+    for(auto& task : _pending)
+    {
+        task->cancel();
+    }
+}
+
+void StructTableModel::requestRows(int row) const
+{
+    int block = row / STRUCT_BLOCK_ROWS;
+    if(_pending.contains(block)) return;
+
+    // 这一块里所有字段的引用一起解析
+    size_t row0 = (size_t)block * STRUCT_BLOCK_ROWS;
+    size_t row1 = row0 + STRUCT_BLOCK_ROWS;
+    std::vector<hobj_ref_t> refs;
+    for(auto& f : *_fields)
+    {
+        for(size_t r=row0; r<std::min(row1, f.refs.size()); r++) refs.push_back(f.refs[r]);
+    }
+    auto self = const_cast<StructTableModel*>(this);
+    auto task = _executor->submit({}, [self, block, refs, resolver = _resolver](IoTask& task) -> IoTask::Result {
+        if(task.isCancelled()) return {};
+        resolver->resolvePaths(refs);
+        return [self, block](){ self->applyRows(block); };
+    }, self);
+    _pending.insert(block, task);
+}
+
+void StructTableModel::applyRows(int block)
+{
+    _pending.remove(block);
+    int row0 = block * STRUCT_BLOCK_ROWS;
+    int row1 = std::min(row0 + STRUCT_BLOCK_ROWS, rowCount()) - 1;
+    if(row1 >= row0 && columnCount() > 0) emit dataChanged(index(row0, 0), index(row1, columnCount() - 1));
+}
+
+std::vector<hobj_ref_t> StructTableModel::refs(size_t maxRows) const
+{
+    std::vector<hobj_ref_t> res;
+    for(auto& f : *_fields)
+    {
+        res.insert(res.end(), f.refs.begin(), f.refs.begin() + std::min(maxRows, f.refs.size()));
+    }
+    return res;
+}
+
+void StructTableModel::refresh()
+{
+    if(rowCount() > 0 && columnCount() > 0) emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+}
+
+int StructTableModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid()) return 0;
+    return (int)std::min<size_t>(_rows, INT_MAX);
+}
+
+int StructTableModel::columnCount(const QModelIndex &parent) const
+{
+    if(parent.isValid()) return 0;
+    return (int)_fields->size();
+}
+
+QVariant StructTableModel::data(const QModelIndex &index, int role) const
+{
+    // UserRole是双击时跳转的路径
+    if(!index.isValid() || (role != Qt::DisplayRole && role != Qt::UserRole)) return {};
+    auto& f = (*_fields)[index.column()];
+    if(f.refs.empty())
+    {
+        if(index.row() > 0) return {};
+        return role == Qt::DisplayRole ? f.text : f.path;
+    }
+    if((size_t)index.row() >= f.refs.size() || !_resolver) return {};
+    auto ref = f.refs[index.row()];
+    auto info = _resolver->find(ref);
+    if(!info)
+    {
+        if(_executor)
+        {
+            requestRows(index.row());
+            return {};
+        }
+        info = _resolver->resolve(ref);
+    }
+    if(role == Qt::UserRole) return QString::fromStdString(info->path);
+    return info->has_preview ? info->preview : QString::fromStdString(info->path);
+}
+
+QVariant StructTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if(role == Qt::DisplayRole && orientation == Qt::Horizontal && section < (int)_fields->size())
+    {
+        return (*_fields)[section].name;
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
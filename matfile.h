@@ -0,0 +1,125 @@
+#ifndef MATFILE_H
+#define MATFILE_H
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QHash>
+#include "cellformatter.h"
+
+class RefResolver;
+class IoExecutor;
+class IoTask;
+
+// MATLAB v7.3的MAT文件就是HDF5，按MATLAB_class属性区分类型：
+// char是UTF-16编码的uint16，稀疏矩阵是带MATLAB_sparse属性的组（data/ir/jc三个数据集，按列压缩），
+// struct是组，struct数组的每个字段是引用数组；cell和struct数组的元素放在根下的#refs#里
+template <typename Derivate>
+std::string readMatlabClass(const HighFive::AnnotateTraits<Derivate>& obj)
+{
+    const static std::string name = "MATLAB_class";
+    if(!obj.hasAttribute(name)) return {};
+    auto attr = obj.getAttribute(name);
+    auto type = attr.getDataType();
+    if(type.getClass() != HighFive::DataTypeClass::String || type.isVariableStr()) return {};
+    std::string buff(attr.getStorageSize(), 0);
+    attr.read(buff.data(), type);
+    buff.resize(strnlen(buff.data(), buff.size()));
+    return buff;
+}
+
+// MATLAB自己用的组（#refs#、#subsystem#），不在树里显示
+inline bool isMatInternal(const QString& name)
+{
+    return name == "#refs#" || name == "#subsystem#";
+}
+
+// logical存成uint8，显示成true/false；其他按数值类型选
+CellKernel selectMatKernel(const HighFive::DataType& type, const std::string& mat_class);
+
+// char数组：HDF5的维度是MATLAB的反过来，最后一维是行数，每行的字符隔rows个取一个
+// 一行只有一个字符串时整块一次转换
+QStringList decodeMatChar(const void* data, size_t count, size_t size, size_t rows);
+
+// 稀疏矩阵按需读取的虚拟稠密视图：只把jc读进来，列在显示时才读对应的ir和data，不展开成稠密矩阵
+// 有IoExecutor时列在后台读取，完成后通过dataChanged刷新
+class SparseTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    struct Source
+    {
+        std::shared_ptr<HighFive::DataSet> data; // 没有非零元素时为空
+        std::shared_ptr<HighFive::DataSet> ir;
+        std::vector<uint64_t> jc;
+        size_t rows{0};
+        CellKernel kernel;
+    };
+    // 后台线程调用（要拿HDF5的锁）；不是稀疏矩阵时返回空
+    static std::shared_ptr<const Source> load(const HighFive::Group& group);
+
+    explicit SparseTableModel(std::shared_ptr<const Source> source, IoExecutor* executor = nullptr, QObject *parent = nullptr);
+    ~SparseTableModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    struct Column
+    {
+        std::vector<uint64_t> ir;
+        std::vector<uint8_t> values;
+    };
+    static std::shared_ptr<Column> readColumn(const Source& source, int col); // 读取失败时是空列
+    const Column* column(int col) const; // 还没读进来时返回空
+    void insertColumn(int col, std::shared_ptr<Column> c) const;
+    void applyColumn(int col, std::shared_ptr<Column> c);
+
+    std::shared_ptr<const Source> _source;
+    IoExecutor* _executor;
+    mutable QCache<int, Column> _columns; // 按非零元素个数计算开销
+    mutable QHash<int, std::shared_ptr<IoTask>> _pending;
+};
+
+// struct的字段表：标量struct一行，每个字段一列；struct数组每个元素一行，单元格是引用，显示引用对象的预览
+// 有IoExecutor时没解析过的引用按行块在后台解析，完成后通过dataChanged刷新
+class StructTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    struct Field
+    {
+        QString name;
+        std::vector<hobj_ref_t> refs; // struct数组的字段
+        QString text; // 标量struct的字段
+        QString path;
+    };
+    using Preview = std::function<QString(const HighFive::DataSet&)>;
+    // 后台线程调用（要拿HDF5的锁）；不是struct时返回空
+    static std::shared_ptr<const std::vector<Field>> load(const HighFive::Group& group, const Preview& preview);
+
+    StructTableModel(std::shared_ptr<const std::vector<Field>> fields, std::shared_ptr<RefResolver> resolver, IoExecutor* executor = nullptr, QObject *parent = nullptr);
+    ~StructTableModel();
+
+    std::vector<hobj_ref_t> refs(size_t maxRows) const; // 前maxRows行的引用，用来批量准备预览
+    void refresh(); // 预览准备好以后刷新
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    void requestRows(int row) const;
+    void applyRows(int block);
+
+    std::shared_ptr<const std::vector<Field>> _fields;
+    std::shared_ptr<RefResolver> _resolver;
+    IoExecutor* _executor;
+    size_t _rows{1};
+    mutable QHash<int, std::shared_ptr<IoTask>> _pending;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "prefix.h"
+#include "matfile.h"
+#include "ioexecutor.h"
+#include <QTemporaryDir>
+#include <QSignalSpy>
+#include <QtTest>
+
+// MATLAB的char按列存放，稀疏矩阵按列压缩；在临时文件里按MATLAB的格式写几个小矩阵
+class MatFileTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(_dir.isValid());
+        _file = std::make_unique<HighFive::File>(_dir.filePath("sparse.mat").toStdString(), HighFive::File::Truncate);
+        // 3×3：第0列第0、2行，第1列全是0，第2列第1行
+        writeSparse("S", "double", 3, std::vector<double>{1.5, 2, 3}, {0, 2, 1}, {0, 2, 2, 3});
+        writeSparse("L", "logical", 2, std::vector<uint8_t>{1}, {1}, {0, 0, 1});
+        auto empty = _file->createGroup("Z");
+        writeMatlabClass(empty.getId(), "double");
+        uint64_t rows = 4;
+        empty.createAttribute<uint64_t>("MATLAB_sparse", HighFive::DataSpace::From(rows)).write(rows);
+        std::vector<uint64_t> jc{0, 0};
+        empty.createDataSet<uint64_t>("jc", HighFive::DataSpace::From(jc)).write(jc);
+    }
+
+    void charSingleRow()
+    {
+        std::vector<ushort> text{'h', 0xe9, 'l', 'l', 'o'};
+        QCOMPARE(decodeMatChar(text.data(), text.size(), 2, 1), QStringList{QString::fromUtf8("héllo")});
+    }
+
+    void charRowsAreInterleaved()
+    {
+        // ["ab";"cd"]按列存放是a c b d
+        std::vector<ushort> text{'a', 'c', 'b', 'd'};
+        QCOMPARE(decodeMatChar(text.data(), text.size(), 2, 2), (QStringList{"ab", "cd"}));
+        std::vector<uint8_t> latin{'a', 'c', 'b', 'd'};
+        QCOMPARE(decodeMatChar(latin.data(), latin.size(), 1, 2), (QStringList{"ab", "cd"}));
+        QVERIFY(decodeMatChar(text.data(), text.size(), 4, 1).empty());
+    }
+
+    void internalGroups()
+    {
+        QVERIFY(isMatInternal("#refs#"));
+        QVERIFY(isMatInternal("#subsystem#"));
+        QVERIFY(!isMatInternal("#tag#"));
+        QVERIFY(!isMatInternal("refs"));
+    }
+
+    void sparseColumns()
+    {
+        auto source = SparseTableModel::load(_file->getGroup("S"));
+        QVERIFY(source);
+        SparseTableModel model(source);
+        QCOMPARE(model.rowCount(), 3);
+        QCOMPARE(model.columnCount(), 3);
+        QCOMPARE(cell(model, 0, 0), QString("1.5"));
+        QCOMPARE(cell(model, 1, 0), QString("0"));
+        QCOMPARE(cell(model, 2, 0), QString("2"));
+        QCOMPARE(cell(model, 0, 1), QString("0"));
+        QCOMPARE(cell(model, 1, 2), QString("3"));
+    }
+
+    void sparseAllZero()
+    {
+        auto source = SparseTableModel::load(_file->getGroup("Z"));
+        QVERIFY(source);
+        SparseTableModel model(source);
+        QCOMPARE(model.rowCount(), 4);
+        QCOMPARE(model.columnCount(), 1);
+        QCOMPARE(cell(model, 3, 0), QString("0"));
+    }
+
+    void sparseLogical()
+    {
+        auto source = SparseTableModel::load(_file->getGroup("L"));
+        QVERIFY(source);
+        SparseTableModel model(source);
+        QCOMPARE(cell(model, 1, 1), QString("true"));
+        QCOMPARE(cell(model, 0, 1), QString("0"));
+    }
+
+    void sparseColumnLoadsInBackground()
+    {
+        IoExecutor executor;
+        auto source = SparseTableModel::load(_file->getGroup("S"));
+        SparseTableModel model(source, &executor);
+        QSignalSpy changed(&model, &QAbstractItemModel::dataChanged);
+        QVERIFY(!model.data(model.index(2, 0)).isValid()); // 第一次还没读进来
+        QVERIFY(changed.wait());
+        QCOMPARE(cell(model, 2, 0), QString("2"));
+    }
+
+private:
+    template<class T>
+    void writeSparse(const std::string& name, const char* cls, uint64_t rows, const std::vector<T>& data, const std::vector<uint64_t>& ir, const std::vector<uint64_t>& jc)
+    {
+        auto group = _file->createGroup(name);
+        writeMatlabClass(group.getId(), cls);
+        group.createAttribute<uint64_t>("MATLAB_sparse", HighFive::DataSpace::From(rows)).write(rows);
+        group.createDataSet<T>("data", HighFive::DataSpace::From(data)).write(data);
+        group.createDataSet<uint64_t>("ir", HighFive::DataSpace::From(ir)).write(ir);
+        group.createDataSet<uint64_t>("jc", HighFive::DataSpace::From(jc)).write(jc);
+    }
+
+    static void writeMatlabClass(hid_t obj, const char* cls)
+    {
+        // MATLAB写的是定长的ASCII字符串
+        hid_t type = H5Tcopy(H5T_C_S1);
+        H5Tset_size(type, strlen(cls));
+        hid_t space = H5Screate(H5S_SCALAR);
+        hid_t attr = H5Acreate2(obj, "MATLAB_class", type, space, H5P_DEFAULT, H5P_DEFAULT);
+        H5Awrite(attr, type, cls);
+        H5Aclose(attr);
+        H5Sclose(space);
+        H5Tclose(type);
+    }
+
+    static QString cell(const QAbstractItemModel& model, int row, int col)
+    {
+        return model.data(model.index(row, col)).toString();
+    }
+
+    QTemporaryDir _dir;
+    std::unique_ptr<HighFive::File> _file;
+};
+
+QTEST_GUILESS_MAIN(MatFileTest)
+#include "matfile_test.moc"
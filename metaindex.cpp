@@ -0,0 +1,347 @@
+#include "prefix.h"
+#include "metaindex.h"
+#include "helper.h"
+#include "matfile.h"
+#include "hdf5lock.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <set>
+
+namespace
+{
+    constexpr char MAGIC[8] = {'H', '5', 'P', 'A', 'D', 'I', 'D', 'X'};
+    constexpr uint32_t VERSION = 1;
+    constexpr uint8_t FLAG_CHILDREN = 1; // 子节点已经索引
+    constexpr size_t BATCH_SIZE = 256; // 每次拿锁处理的子节点个数
+
+    struct Child
+    {
+        std::string name;
+        H5O_type_t type{H5O_TYPE_UNKNOWN};
+        std::string key;
+    };
+
+    herr_t collectLink(hid_t loc, const char* name, const H5L_info_t*, void* op_data)
+    {
+        auto children = static_cast<std::vector<Child>*>(op_data);
+        Child child;
+        child.name = name;
+        H5O_info_t info;
+        if(H5Oget_info_by_name(loc, name, &info, H5O_INFO_BASIC, H5P_DEFAULT) >= 0)
+        {
+            child.type = info.type;
+            child.key = objectKey(info);
+        }
+        children->push_back(std::move(child));
+        return children->size() % BATCH_SIZE == 0 ? 1 : 0; // 返回正数让H5Literate停下，放开锁后从idx继续
+    }
+}
+
+struct MetaIndex::Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t strings_size;
+};
+
+struct MetaIndex::Record
+{
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t child_count;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t name_off;
+    uint32_t name_len;
+    uint32_t type_off;
+    uint32_t type_len;
+    uint32_t class_off;
+    uint32_t class_len;
+};
+
+QString MetaIndex::indexFileName(const QString& fileName)
+{
+    auto path = QFileInfo(fileName).absoluteFilePath();
+    auto hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex();
+    auto dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/index";
+    return dir + "/" + QString::fromLatin1(hash) + ".idx";
+}
+
+std::shared_ptr<const MetaIndex> MetaIndex::open(const QString& fileName)
+{
+    QFileInfo info(fileName);
+    auto file = std::make_unique<QFile>(indexFileName(fileName));
+    if(!info.exists() || !file->open(QIODevice::ReadOnly) || file->size() < (qint64)sizeof(Header)) return nullptr;
+    auto base = file->map(0, file->size());
+    if(!base) return nullptr;
+
+    Header header;
+    memcpy(&header, base, sizeof(header));
+    if(memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) return nullptr;
+    if(header.file_size != (uint64_t)info.size() || header.file_mtime != info.lastModified().toMSecsSinceEpoch()) return nullptr;
+    if(header.count == 0 || header.strings_size > (uint64_t)file->size()) return nullptr;
+    if(sizeof(Header) + (uint64_t)header.count * sizeof(Record) + header.strings_size != (uint64_t)file->size()) return nullptr;
+    // 写了一半或者被改坏的索引返回空，调用的地方会重建
+    if(!validate((const Record*)(base + sizeof(Header)), header.count)) return nullptr;
+
+    std::shared_ptr<MetaIndex> index(new MetaIndex());
+    index->_base = base;
+    index->_records = (const Record*)(base + sizeof(Header));
+    index->_count = header.count;
+    index->_strings = (const char*)(base + sizeof(Header) + (size_t)header.count * sizeof(Record));
+    index->_strings_size = header.strings_size;
+    index->_file = std::move(file);
+    return index;
+}
+
+bool MetaIndex::validate(const Record* records, uint32_t count)
+{
+    // 节点按层次排列：父节点在前面，子节点是后面连续的一段；字符串的范围在string()里检查
+    for(uint32_t i=0; i<count; i++)
+    {
+        auto& r = records[i];
+        if(i == ROOT ? r.parent != NPOS : r.parent >= i) return false;
+        if(!(r.flags & FLAG_CHILDREN))
+        {
+            if(r.child_count != 0) return false;
+            continue;
+        }
+        if(r.child_count > 0 && (r.first_child <= i || r.first_child > count || r.child_count > count - r.first_child)) return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const MetaIndex> MetaIndex::build(const HighFive::File& file, const QString& fileName,
+    const std::function<bool(size_t objects)>& cancelled)
+{
+    QFileInfo info(fileName);
+    std::vector<Record> records;
+    std::string strings;
+    auto addString = [&strings](const std::string& s, uint32_t& off, uint32_t& len){
+        off = (uint32_t)strings.size();
+        len = (uint32_t)s.size();
+        strings += s;
+    };
+
+    // 按层次逐个组枚举，子节点连续地加在后面
+    Record root{};
+    root.parent = NPOS;
+    root.type = (uint8_t)HighFive::ObjectType::Group;
+    records.push_back(root);
+    std::vector<std::pair<uint32_t, std::string>> queue{{ROOT, "/"}};
+    std::set<std::string> visited;
+    // 组的句柄要拿着锁释放
+    std::optional<HighFive::Group> opened;
+    auto release = [&opened](){
+        H5Lock lock(hdf5Mutex());
+        opened.reset();
+    };
+    for(size_t q=0; q<queue.size(); q++)
+    {
+        if(cancelled && cancelled(records.size())) return nullptr;
+        auto [node, path] = queue[q];
+        // 每批子节点单独拿锁，批之间让一让，界面要读的数据不用等整个组遍历完
+        if(q > 0) QThread::yieldCurrentThread();
+
+        {
+            H5Lock lock(hdf5Mutex());
+            try {
+                opened.emplace(file.getGroup(path));
+            }
+            catch(const HighFive::Exception&) {
+                continue; // 打不开的组不索引子节点，展开时再访问HDF5
+            }
+            if(node == ROOT)
+            {
+                H5O_info_t root_info;
+                if(H5Oget_info(opened->getId(), &root_info, H5O_INFO_BASIC) >= 0) visited.insert(objectKey(root_info));
+            }
+        }
+        std::vector<Child> children;
+        hsize_t idx = 0;
+        for(herr_t more = 1; more > 0; )
+        {
+            if(cancelled && cancelled(records.size() + children.size()))
+            {
+                release();
+                return nullptr;
+            }
+            H5Lock lock(hdf5Mutex());
+            more = H5Literate(opened->getId(), H5_INDEX_NAME, H5_ITER_INC, &idx, collectLink, &children);
+        }
+        std::sort(children.begin(), children.end(), [](const Child& a, const Child& b){ return a.name < b.name; });
+
+        records[node].flags |= FLAG_CHILDREN;
+        records[node].first_child = (uint32_t)records.size();
+        records[node].child_count = (uint32_t)children.size();
+        for(size_t begin=0; begin<children.size(); begin+=BATCH_SIZE)
+        {
+            if(begin > 0) QThread::yieldCurrentThread();
+            H5Lock lock(hdf5Mutex());
+            auto& group = *opened;
+            auto end = std::min(begin + BATCH_SIZE, children.size());
+            for(size_t c=begin; c<end; c++)
+            {
+                if(cancelled && cancelled(records.size()))
+                {
+                    opened.reset();
+                    return nullptr;
+                }
+                auto& child = children[c];
+                Record r{};
+                r.parent = node;
+                auto type = toObjectType(child.type);
+                r.type = (uint8_t)type;
+                addString(child.name, r.name_off, r.name_len);
+
+                auto type_str = typeToStr(type);
+                std::string mat_class;
+                auto child_path = (path == "/" ? "" : path) + "/" + child.name;
+                try {
+                    if(type == HighFive::ObjectType::Dataset)
+                    {
+                        auto ds = group.getDataSet(child.name);
+                        type_str += "(" + datasetTypeStr(ds) + ")";
+                        mat_class = readMatlabClass(ds);
+                    }
+                    else if(type == HighFive::ObjectType::Group)
+                    {
+                        mat_class = readMatlabClass(group.getGroup(child.name));
+                    }
+                }
+                catch(const HighFive::Exception&) {
+                }
+                addString(type_str.toStdString(), r.type_off, r.type_len);
+                addString(mat_class, r.class_off, r.class_len);
+
+                if(type == HighFive::ObjectType::Group && !child.key.empty() && visited.insert(child.key).second)
+                {
+                    queue.emplace_back((uint32_t)records.size(), child_path);
+                }
+                records.push_back(r);
+            }
+        }
+        release();
+    }
+    if(strings.size() > UINT32_MAX) return nullptr;
+
+    // 先写到临时文件，写完再替换，不会留下写了一半的索引
+    auto indexName = indexFileName(fileName);
+    QDir().mkpath(QFileInfo(indexName).absolutePath());
+    QSaveFile out(indexName);
+    if(!out.open(QIODevice::WriteOnly)) return nullptr;
+    Header header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = (uint32_t)records.size();
+    header.file_size = (uint64_t)info.size();
+    header.file_mtime = info.lastModified().toMSecsSinceEpoch();
+    header.strings_size = strings.size();
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)records.data(), (qint64)(records.size() * sizeof(Record)));
+    out.write(strings.data(), (qint64)strings.size());
+    if(!out.commit()) return nullptr;
+    return open(fileName);
+}
+
+const MetaIndex::Record& MetaIndex::record(uint32_t node) const
+{
+    // 越界的节点当作没有名字、没有子节点的空节点
+    static const Record empty{NPOS, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    return node < _count ? _records[node] : empty;
+}
+
+std::string_view MetaIndex::string(uint32_t offset, uint32_t length) const
+{
+    if((uint64_t)offset + length > _strings_size) return {};
+    return std::string_view(_strings + offset, length);
+}
+
+uint32_t MetaIndex::size() const
+{
+    return _count;
+}
+
+uint32_t MetaIndex::find(std::string_view path) const
+{
+    uint32_t node = ROOT;
+    while(!path.empty())
+    {
+        auto slash = path.find('/');
+        auto part = path.substr(0, slash);
+        path = slash == std::string_view::npos ? std::string_view{} : path.substr(slash + 1);
+        if(part.empty() || part == ".") continue;
+        if(!childrenIndexed(node)) return NPOS;
+
+        // 子节点按名字排序，二分查找
+        auto begin = childBegin(node);
+        auto end = begin + childCount(node);
+        auto itr = std::partition_point(_records + begin, _records + end, [&](const Record& r){
+            return string(r.name_off, r.name_len) < part;
+        });
+        if(itr == _records + end || string(itr->name_off, itr->name_len) != part) return NPOS;
+        node = (uint32_t)(itr - _records);
+    }
+    return node;
+}
+
+uint32_t MetaIndex::parent(uint32_t node) const
+{
+    return record(node).parent;
+}
+
+uint32_t MetaIndex::childBegin(uint32_t node) const
+{
+    return record(node).first_child;
+}
+
+uint32_t MetaIndex::childCount(uint32_t node) const
+{
+    return record(node).child_count;
+}
+
+bool MetaIndex::childrenIndexed(uint32_t node) const
+{
+    return record(node).flags & FLAG_CHILDREN;
+}
+
+HighFive::ObjectType MetaIndex::type(uint32_t node) const
+{
+    return (HighFive::ObjectType)record(node).type;
+}
+
+std::string_view MetaIndex::name(uint32_t node) const
+{
+    return string(record(node).name_off, record(node).name_len);
+}
+
+std::string_view MetaIndex::typeStr(uint32_t node) const
+{
+    return string(record(node).type_off, record(node).type_len);
+}
+
+std::string_view MetaIndex::matlabClass(uint32_t node) const
+{
+    return string(record(node).class_off, record(node).class_len);
+}
+
+std::string MetaIndex::path(uint32_t node) const
+{
+    std::vector<std::string_view> parts;
+    for(; node != ROOT && node != NPOS; node = parent(node)) parts.push_back(name(node));
+    std::string res;
+    for(auto itr = parts.rbegin(); itr != parts.rend(); ++itr)
+    {
+        res += "/";
+        res += *itr;
+    }
+    return res.empty() ? "/" : res;
+}
@@ -0,0 +1,52 @@
+#ifndef METAINDEX_H
+#define METAINDEX_H
+
+#include <QFile>
+#include <string_view>
+
+// 文件里所有对象的层次、类型字符串和MATLAB_class的索引，存在缓存目录里，按文件路径、大小和修改时间区分
+// 索引文件是紧凑的二进制格式，打开时直接映射到内存；文件没改过时树和类型字符串都从索引里取，不再访问HDF5
+// 格式：Header，Record数组（按层次排列，同一个组的子节点连续并按名字排序），字符串区
+class MetaIndex
+{
+public:
+    static constexpr uint32_t ROOT = 0;
+    static constexpr uint32_t NPOS = UINT32_MAX;
+
+    // 没有索引、文件改过或者索引文件不完整（头、节点个数、大小、父子节点的下标对不上）时返回nullptr
+    static std::shared_ptr<const MetaIndex> open(const QString& fileName);
+    // 遍历整个文件建立索引并写到缓存目录，可以在后台线程调用（要拿HDF5的锁）。cancelled返回true时放弃
+    static std::shared_ptr<const MetaIndex> build(const HighFive::File& file, const QString& fileName,
+        const std::function<bool(size_t objects)>& cancelled = nullptr);
+
+    uint32_t size() const;
+    uint32_t find(std::string_view path) const; // "/a/b"，找不到返回NPOS
+    uint32_t parent(uint32_t node) const;
+    uint32_t childBegin(uint32_t node) const;
+    uint32_t childCount(uint32_t node) const;
+    bool childrenIndexed(uint32_t node) const; // 同一个组有多个链接时只有第一个下面有子节点
+    HighFive::ObjectType type(uint32_t node) const;
+    std::string_view name(uint32_t node) const;
+    std::string_view typeStr(uint32_t node) const; // 和树上显示的一样
+    std::string_view matlabClass(uint32_t node) const;
+    std::string path(uint32_t node) const;
+
+    static QString indexFileName(const QString& fileName); // 缓存目录里的索引文件
+
+private:
+    struct Header;
+    struct Record;
+    MetaIndex() = default;
+    const Record& record(uint32_t node) const; // 越界时返回空节点
+    std::string_view string(uint32_t offset, uint32_t length) const;
+    static bool validate(const Record* records, uint32_t count);
+
+    std::unique_ptr<QFile> _file; // 映射区随QFile一起释放
+    const uint8_t* _base{nullptr};
+    const Record* _records{nullptr};
+    uint32_t _count{0};
+    const char* _strings{nullptr};
+    uint64_t _strings_size{0};
+};
+
+#endif
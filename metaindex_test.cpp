@@ -0,0 +1,122 @@
+#include "prefix.h"
+#include "metaindex.h"
+#include <QTemporaryDir>
+#include <QStandardPaths>
+#include <QtTest>
+
+// 索引文件被截断、节点个数或父子下标不对时open要返回空，让调用的地方重建
+class MetaIndexTest : public QObject
+{
+    Q_OBJECT
+
+    // 和metaindex.cpp里的格式一致：Header 40字节，Record 40字节
+    static constexpr qint64 HEADER_SIZE = 40;
+    static constexpr qint64 RECORD_SIZE = 40;
+    static constexpr qint64 PARENT = 0;
+    static constexpr qint64 FIRST_CHILD = 4;
+    static constexpr qint64 COUNT = 12; // Header里的节点个数
+
+private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+        QVERIFY(_dir.isValid());
+        _fileName = _dir.filePath("small.h5");
+        HighFive::File file(_fileName.toStdString(), HighFive::File::Truncate);
+        auto group = file.createGroup("a").createGroup("b");
+        std::vector<int> values{1, 2, 3};
+        group.createDataSet<int>("c", HighFive::DataSpace::From(values)).write(values);
+        file.createGroup("d");
+    }
+
+    void init()
+    {
+        HighFive::File file(_fileName.toStdString(), HighFive::File::ReadOnly);
+        QVERIFY(MetaIndex::build(file, _fileName));
+    }
+
+    void openValidIndex()
+    {
+        auto index = MetaIndex::open(_fileName);
+        QVERIFY(index);
+        QCOMPARE(index->size(), 5u);
+        auto node = index->find("/a/b/c");
+        QVERIFY(node != MetaIndex::NPOS);
+        QCOMPARE(index->path(node), std::string("/a/b/c"));
+        QCOMPARE(index->type(node), HighFive::ObjectType::Dataset);
+        QCOMPARE(index->find("/a/x"), MetaIndex::NPOS);
+    }
+
+    void outOfRangeNodeIsEmpty()
+    {
+        auto index = MetaIndex::open(_fileName);
+        QVERIFY(index);
+        QCOMPARE(index->childCount(1000), 0u);
+        QVERIFY(index->name(1000).empty());
+        QCOMPARE(index->parent(1000), MetaIndex::NPOS);
+    }
+
+    void rejectTruncated()
+    {
+        QFile file(MetaIndex::indexFileName(_fileName));
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.resize(file.size() - 1));
+        file.close();
+        QVERIFY(!MetaIndex::open(_fileName));
+    }
+
+    void rejectWrongCount()
+    {
+        patch(COUNT, 1000);
+        QVERIFY(!MetaIndex::open(_fileName));
+    }
+
+    void rejectChildOutOfRange()
+    {
+        patch(HEADER_SIZE + FIRST_CHILD, 1000); // 根的子节点
+        QVERIFY(!MetaIndex::open(_fileName));
+    }
+
+    void rejectParentAfterChild()
+    {
+        patch(HEADER_SIZE + RECORD_SIZE + PARENT, 4); // 第1个节点的父节点在它后面
+        QVERIFY(!MetaIndex::open(_fileName));
+    }
+
+    void wideGroupInBatches()
+    {
+        // 子节点多于一批，分几次拿锁读完，仍然按名字排好
+        auto fileName = _dir.filePath("wide.h5");
+        {
+            HighFive::File file(fileName.toStdString(), HighFive::File::Truncate);
+            auto group = file.createGroup("wide");
+            for(int i=0; i<600; i++) group.createGroup(QString("g%1").arg(599 - i, 3, 10, QChar('0')).toStdString());
+        }
+        HighFive::File file(fileName.toStdString(), HighFive::File::ReadOnly);
+        QVERIFY(MetaIndex::build(file, fileName));
+        auto index = MetaIndex::open(fileName);
+        QVERIFY(index);
+        auto wide = index->find("/wide");
+        QCOMPARE(index->childCount(wide), 600u);
+        QCOMPARE(index->name(index->childBegin(wide)), std::string_view("g000"));
+        QCOMPARE(index->name(index->childBegin(wide) + 599), std::string_view("g599"));
+
+        // 在组里取消也能马上停下
+        QVERIFY(!MetaIndex::build(file, fileName, [](size_t objects){ return objects > 300; }));
+    }
+
+private:
+    void patch(qint64 offset, uint32_t value)
+    {
+        QFile file(MetaIndex::indexFileName(_fileName));
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.seek(offset));
+        QCOMPARE(file.write((const char*)&value, sizeof(value)), (qint64)sizeof(value));
+    }
+
+    QTemporaryDir _dir;
+    QString _fileName;
+};
+
+QTEST_GUILESS_MAIN(MetaIndexTest)
+#include "metaindex_test.moc"
@@ -1,29 +1,349 @@
 #include "prefix.h"
 #include "pager.h"
+#include "hdf5lock.h"
+#include "parallel.h"
+#include "helper.h"
+#include <zlib.h>
 
-Pager::Pager(std::vector<uint8_t> buffer, const std::vector<hsize_t>& dims, size_t data_size)
-:_buffer(std::move(buffer)), _data_size(data_size)
+namespace
 {
-    // std::vector<hsize_t> _hi_dims;
-    // size_t _colCount;
-    // size_t _rowCount;
+    constexpr size_t TILE_ROWS = 256;
+    constexpr size_t TILE_COLS = 256;
+    constexpr size_t TILE_CACHE_SIZE = 64;
+    constexpr size_t VLEN_TILE_CACHE_SIZE = 16; // 变长数据的块还占着HDF5分配的内存，少留几块
+    constexpr size_t MAX_CACHED_CHUNK = 16u << 20; // 更大的chunk不进ChunkCache，直接按块读
+    constexpr size_t MIN_H5_CHUNK_CACHE = 1u << 20;
+    constexpr size_t MAX_H5_CHUNK_CACHE = 64u << 20;
+    constexpr size_t H5_CHUNK_CACHE_SLOTS = 10007;
 
-    if (dims.size() == 1)
+    std::string getName(hid_t id, ssize_t (*fn)(hid_t, char*, size_t))
     {
-        _colCount = dims.back();
+        std::string name;
+        auto len = fn(id, nullptr, 0);
+        if(len > 0)
+        {
+            name.resize(len + 1);
+            fn(id, name.data(), len + 1);
+            name.resize(len);
+        }
+        return name;
     }
-    else if (dims.size() > 1)
+
+    std::string fileName(hid_t id)
+    {
+        return getName(id, &H5Fget_name);
+    }
+
+    std::string objectPath(hid_t id)
+    {
+        return getName(id, &H5Iget_name);
+    }
+
+    QThreadPool& inflatePool()
+    {
+        static QThreadPool pool;
+        return pool;
+    }
+
+    // 按写入时的相反顺序撤销过滤器，mask里置位的过滤器写入时被跳过了
+    bool decodeChunk(std::vector<uint8_t>& buf, const std::vector<H5Z_filter_t>& filters, uint32_t mask, size_t chunk_bytes, size_t type_size)
+    {
+        for(size_t i=filters.size(); i>0; i--)
+        {
+            if(mask & (1u << (i-1))) continue;
+            if(filters[i-1] == H5Z_FILTER_DEFLATE)
+            {
+                std::vector<uint8_t> out(chunk_bytes);
+                uLongf len = (uLongf)chunk_bytes;
+                if(uncompress(out.data(), &len, buf.data(), (uLong)buf.size()) != Z_OK || len != chunk_bytes) return false;
+                buf.swap(out);
+            }
+            else if(filters[i-1] == H5Z_FILTER_SHUFFLE)
+            {
+                // 先是所有元素的第0字节，再是第1字节……，凑不满一个元素的尾巴原样保留
+                auto n = buf.size() / type_size;
+                std::vector<uint8_t> out(buf);
+                for(size_t b=0; b<type_size; b++)
+                {
+                    for(size_t e=0; e<n; e++) out[e * type_size + b] = buf[b * n + e];
+                }
+                buf.swap(out);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return buf.size() == chunk_bytes;
+    }
+
+    size_t alignTile(size_t tile, hsize_t chunk)
     {
-        _colCount = dims.back();
-        _rowCount = dims[dims.size()-2];
+        if(chunk == 0 || chunk > tile) return tile;
+        return tile / chunk * chunk;
     }
+}
 
-    if(dims.size() > 2)
+PageSlice viewSlice(PageSlice slice, size_t rank, bool matlabOrder)
+{
+    if(rank < 2) return slice;
+    if(slice.colAxis < 0)
+    {
+        slice.colAxis = (int)rank - 1;
+        slice.rowAxis = (int)rank - 2;
+    }
+    if(slice.rowAxis >= 0 && slice.transposed() != matlabOrder) slice = slice.swapped();
+    return slice;
+}
+
+void transposeBlock(const uint8_t* src, uint8_t* dst, size_t rows, size_t cols, size_t size)
+{
+    constexpr size_t BLOCK = 32;
+    for(size_t r0=0; r0<rows; r0+=BLOCK)
     {
-        _hi_dims.insert(_hi_dims.end(), dims.begin(), dims.end() - 2);
+        for(size_t c0=0; c0<cols; c0+=BLOCK)
+        {
+            auto r1 = std::min(r0 + BLOCK, rows);
+            auto c1 = std::min(c0 + BLOCK, cols);
+            for(size_t r=r0; r<r1; r++)
+            {
+                for(size_t c=c0; c<c1; c++) memcpy(dst + (r * cols + c) * size, src + (c * rows + r) * size, size);
+            }
+        }
     }
 }
 
+Pager::Pager(const HighFive::DataSet& dataset, const std::vector<size_t>& dims, size_t data_size, PageSlice slice, std::vector<std::string> fields)
+:_dataset(dataset), _data_type(dataset.getDataType()), _dims(dims), _data_size(data_size), _slice(slice), _fields(std::move(fields))
+{
+    int rank = (int)dims.size();
+    if(_slice.colAxis < 0)
+    {
+        _slice.colAxis = rank - 1;
+        _slice.rowAxis = std::max(rank - 2, -1);
+    }
+    _slice.rowStep = std::max<size_t>(_slice.rowStep, 1);
+    _slice.colStep = std::max<size_t>(_slice.colStep, 1);
+    if(rank > 0 && (_slice.colAxis >= rank || _slice.rowAxis >= rank || _slice.rowAxis == _slice.colAxis))
+    {
+        throw HighFive::DataSpaceException("Invalid page axes");
+    }
+
+    if (_slice.colAxis >= 0)
+    {
+        _colCount = (dims[_slice.colAxis] + _slice.colStep - 1) / _slice.colStep;
+    }
+    if (_slice.rowAxis >= 0)
+    {
+        _rowCount = (dims[_slice.rowAxis] + _slice.rowStep - 1) / _slice.rowStep;
+    }
+
+    for(int d=0; d<rank; d++)
+    {
+        if(d == _slice.rowAxis || d == _slice.colAxis) continue;
+        _page_axes.push_back(d);
+        _hi_dims.push_back(dims[d]);
+    }
+
+    _tile_rows = TILE_ROWS;
+    _tile_cols = TILE_COLS;
+    {
+        H5Lock lock(hdf5Mutex());
+        _vlen = hasVlenData(_data_type->getId());
+    }
+    tryMap();
+    initMembers();
+    if(!_mapped) initChunks();
+}
+
+void Pager::initMembers()
+{
+    H5Lock lock(hdf5Mutex());
+    if(_data_type->getClass() != HighFive::DataTypeClass::Compound) return;
+    auto all = HighFive::CompoundType(HighFive::DataType(*_data_type)).getMembers();
+    if(_fields.empty())
+    {
+        _members = std::move(all);
+        return;
+    }
+    for(auto& name : _fields)
+    {
+        auto itr = std::find_if(all.begin(), all.end(), [&](const auto& m){ return m.name == name; });
+        if(itr != all.end()) _members.push_back(*itr);
+    }
+    if(_members.empty()) throw HighFive::DataTypeException("No such compound member");
+    // 映射时所有成员本来就在内存里，直接用原来的偏移
+    if(_mapped) return;
+
+    // 按名字匹配的部分读取：内存类型里的成员紧挨着放，HDF5只把这几个成员转换出来
+    size_t offset = 0;
+    for(auto& m : _members)
+    {
+        m.offset = offset;
+        offset += m.base_type.getSize();
+    }
+    _mem_type = H5Tcreate(H5T_COMPOUND, offset);
+    if(_mem_type < 0) throw HighFive::DataTypeException("Unable to create member type");
+    for(auto& m : _members)
+    {
+        if(H5Tinsert(_mem_type, m.name.c_str(), m.offset, m.base_type.getId()) < 0)
+        {
+            // 构造函数抛出异常时析构函数不会执行，这里自己关掉
+            H5Tclose(_mem_type);
+            _mem_type = H5I_INVALID_HID;
+            throw HighFive::DataTypeException("Unable to insert member " + m.name);
+        }
+    }
+    _data_size = offset;
+}
+
+void Pager::tryMap()
+{
+    // 只有文件里的字节和H5Dread读出来的完全一样时才能映射：
+    // 连续存储、没有过滤器、没有外部文件、已经分配空间、文件用默认驱动打开；变长和引用类型的内容不在数据集里
+    H5Lock lock(hdf5Mutex());
+    auto type_id = _data_type->getId();
+    if(_vlen || H5Tget_class(type_id) == H5T_REFERENCE || H5Tdetect_class(type_id, H5T_REFERENCE) > 0) return;
+
+    hid_t dcpl = H5Dget_create_plist(_dataset->getId());
+    if(dcpl < 0) return;
+    bool plain = H5Pget_layout(dcpl) == H5D_CONTIGUOUS && H5Pget_nfilters(dcpl) == 0 && H5Pget_external_count(dcpl) == 0;
+    H5Pclose(dcpl);
+    if(!plain) return;
+
+    haddr_t offset = H5Dget_offset(_dataset->getId());
+    if(offset == HADDR_UNDEF) return;
+
+    hid_t file_id = H5Iget_file_id(_dataset->getId());
+    if(file_id < 0) return;
+    hid_t fapl = H5Fget_access_plist(file_id);
+    bool sec2 = fapl >= 0 && H5Pget_driver(fapl) == H5FD_SEC2;
+    if(fapl >= 0) H5Pclose(fapl);
+    auto file_name = fileName(file_id);
+    H5Fclose(file_id);
+    if(!sec2 || file_name.empty()) return;
+
+    auto bytes = std::accumulate(_dims.begin(), _dims.end(), size_t{1u}, std::multiplies<size_t>()) * _data_size;
+    if(bytes == 0) return;
+    auto file = std::make_shared<QFile>(QString::fromStdString(file_name));
+    if(!file->open(QIODevice::ReadOnly) || (qint64)(offset + bytes) > file->size()) return;
+    auto base = file->map((qint64)offset, (qint64)bytes);
+    if(!base) return;
+    _map_file = std::move(file);
+    _mapped = base;
+}
+
+bool Pager::isMapped() const
+{
+    return _mapped != nullptr;
+}
+
+bool Pager::isDefaultSlice() const
+{
+    // 默认的低2维度、不跳着取时，一页在数据集里是连续的
+    int rank = (int)_dims.size();
+    return _slice.rowStep == 1 && _slice.colStep == 1 && _slice.colAxis == rank - 1 && (rank < 2 || _slice.rowAxis == rank - 2);
+}
+
+size_t Pager::elementIndex(size_t pageIdx, size_t row, size_t col) const
+{
+    auto rank = _dims.size();
+    std::vector<size_t> coord(rank, 0);
+    auto hidim = getHiDimByPage(pageIdx);
+    for(size_t i=0; i<_page_axes.size(); i++) coord[_page_axes[i]] = hidim[i];
+    if(_slice.rowAxis >= 0) coord[_slice.rowAxis] = row * _slice.rowStep;
+    if(_slice.colAxis >= 0) coord[_slice.colAxis] = col * _slice.colStep;
+    size_t idx = 0;
+    for(size_t d=0; d<rank; d++) idx = idx * _dims[d] + coord[d];
+    return idx;
+}
+
+void Pager::initChunks()
+{
+    H5Lock lock(hdf5Mutex());
+    auto rank = _dims.size();
+    if(rank == 0) return;
+    hid_t dcpl = H5Dget_create_plist(_dataset->getId());
+    if(dcpl < 0) return;
+    std::vector<hsize_t> chunk(rank, 0);
+    bool chunked = H5Pget_layout(dcpl) == H5D_CHUNKED && H5Pget_chunk(dcpl, (int)rank, chunk.data()) == (int)rank;
+    H5Pclose(dcpl);
+    if(!chunked) return;
+
+    // 表格块按chunk对齐，读一个块时不会只用到半个chunk；跳着取时对不齐
+    auto row_axis = _slice.rowAxis;
+    auto col_axis = _slice.colAxis;
+    _tile_cols = alignTile(TILE_COLS, _slice.colStep == 1 ? chunk[col_axis] : 0);
+    if(row_axis >= 0) _tile_rows = alignTile(TILE_ROWS, _slice.rowStep == 1 ? chunk[row_axis] : 0);
+
+    // HDF5自己的chunk缓存至少要放得下一个表格块跨过的所有chunk，默认的1MB对大chunk不起作用
+    auto chunk_bytes = std::accumulate(chunk.begin(), chunk.end(), size_t{1u}, std::multiplies<size_t>()) * _data_size;
+    size_t tile_chunks = (_tile_cols * _slice.colStep / chunk[col_axis] + 1) * (row_axis >= 0 ? _tile_rows * _slice.rowStep / chunk[row_axis] + 1 : 1);
+    auto cache_bytes = std::clamp(tile_chunks * chunk_bytes, MIN_H5_CHUNK_CACHE, MAX_H5_CHUNK_CACHE);
+    auto path = objectPath(_dataset->getId());
+    hid_t file_id = H5Iget_file_id(_dataset->getId());
+    if(file_id < 0) return;
+    hid_t dapl = H5Dget_access_plist(_dataset->getId());
+    if(dapl >= 0)
+    {
+        if(H5Pset_chunk_cache(dapl, H5_CHUNK_CACHE_SLOTS, cache_bytes, 1.0) >= 0 && !path.empty())
+        {
+            _read_id = H5Dopen2(file_id, path.c_str(), dapl);
+        }
+        H5Pclose(dapl);
+    }
+    auto file_name = fileName(file_id);
+    H5Fclose(file_id);
+
+    // 变长数据读出来的是HDF5分配的指针，不能缓存
+    auto type_id = _data_type->getId();
+    if(_vlen) return;
+    if(chunk_bytes > MAX_CACHED_CHUNK || path.empty()) return;
+    _chunk_dims = std::move(chunk);
+    _chunk_key = file_name + ":" + path;
+    // 只读部分成员时chunk里的内容不一样，单独缓存
+    for(size_t i=0; _mem_type >= 0 && i<_members.size(); i++) _chunk_key += (i == 0 ? "#" : ";") + _members[i].name;
+
+    // 只有deflate和shuffle时自己解压原始chunk；引用类型在文件里和内存里的格式不一样，还是交给H5Dread
+    if(H5Tdetect_class(type_id, H5T_REFERENCE) > 0 || _mem_type >= 0) return;
+    dcpl = H5Dget_create_plist(_dataset->getId());
+    if(dcpl < 0) return;
+    bool supported = true;
+    auto nfilters = H5Pget_nfilters(dcpl);
+    for(int i=0; i<nfilters; i++)
+    {
+        unsigned flags = 0;
+        size_t cd_nelmts = 0;
+        auto filter = H5Pget_filter2(dcpl, (unsigned)i, &flags, &cd_nelmts, nullptr, 0, nullptr, nullptr);
+        if(filter != H5Z_FILTER_DEFLATE && filter != H5Z_FILTER_SHUFFLE) supported = false;
+        _filters.push_back(filter);
+    }
+    H5Pclose(dcpl);
+    _raw_chunks = supported && nfilters > 0;
+}
+
+hid_t Pager::readId() const
+{
+    return _read_id >= 0 ? _read_id : _dataset->getId();
+}
+
+hid_t Pager::memTypeId() const
+{
+    return _mem_type >= 0 ? _mem_type : _data_type->getId();
+}
+
+Pager::~Pager()
+{
+    // Pager可能在后台线程里最后释放
+    H5Lock lock(hdf5Mutex());
+    if(_page_idx != SIZE_MAX) reclaim(_page_buffer.data(), _page_buffer.size() / _data_size);
+    if(_read_id >= 0) H5Dclose(_read_id);
+    if(_mem_type >= 0) H5Tclose(_mem_type);
+    _members.clear();
+    _dataset.reset();
+    _data_type.reset();
+}
+
 size_t Pager::columnCount() const
 {
     return _colCount;
@@ -36,10 +356,8 @@ size_t Pager::rowCount() const
 
 size_t Pager::pageCount() const
 {
-    auto pageCountByDim = std::accumulate(_hi_dims.begin(), _hi_dims.end(), size_t{1u}, std::multiplies<size_t>());
-    auto bytePerPage = _data_size*_colCount*_rowCount;
-    auto pageCountByBuff =  (_buffer.size() + bytePerPage - 1)/bytePerPage;
-    return std::min<>(pageCountByDim, pageCountByBuff);
+    if(_colCount * _rowCount == 0) return 0;
+    return std::accumulate(_hi_dims.begin(), _hi_dims.end(), size_t{1u}, std::multiplies<size_t>());
 }
 
 size_t Pager::dataSize() const
@@ -47,7 +365,7 @@ size_t Pager::dataSize() const
     return _data_size;
 }
 
-std::vector<size_t> Pager::getHiDimByPage(size_t pageIdx) const // 得到指定页的高维度（低2维度当作表格）
+std::vector<size_t> Pager::getHiDimByPage(size_t pageIdx) const // 得到指定页的高维度（行、列以外的维度）
 {
     std::vector<size_t> res;
     for(auto itr = _hi_dims.rbegin(); itr != _hi_dims.rend(); ++itr)
@@ -60,11 +378,440 @@ std::vector<size_t> Pager::getHiDimByPage(size_t pageIdx) const // 得到指定
     return res;
 }
 
-std::span<uint8_t> Pager::getPageData(size_t pageIdx)
+size_t Pager::getPageByHiDim(const std::vector<size_t>& hidim) const
 {
-    auto size = _buffer.size();
-    auto bytePerPage = _data_size*_colCount*_rowCount;
-    auto begin = std::min(size, bytePerPage * pageIdx);
-    auto end = std::min(size, bytePerPage * pageIdx + bytePerPage);
-    return std::span<uint8_t>(_buffer.begin()+begin, _buffer.begin()+end);
+    if(hidim.size() != _hi_dims.size()) return SIZE_MAX;
+    size_t pageIdx = 0;
+    for(size_t i=0; i<hidim.size(); i++)
+    {
+        if(hidim[i] >= _hi_dims[i]) return SIZE_MAX;
+        pageIdx = pageIdx * _hi_dims[i] + hidim[i];
+    }
+    return pageIdx;
+}
+
+const std::vector<size_t>& Pager::hiDims() const
+{
+    return _hi_dims;
+}
+
+const std::vector<size_t>& Pager::pageAxes() const
+{
+    return _page_axes;
+}
+
+const std::vector<size_t>& Pager::dims() const
+{
+    return _dims;
+}
+
+const PageSlice& Pager::slice() const
+{
+    return _slice;
+}
+
+const std::vector<std::string>& Pager::fields() const
+{
+    return _fields;
+}
+
+const std::vector<Pager::Member>& Pager::members() const
+{
+    return _members;
+}
+
+void Pager::readBlock(size_t pageIdx, size_t row, size_t col, size_t rows, size_t cols, void* dst, size_t rowStep, size_t colStep) const
+{
+    readSelected(pageIdx, row, col, rows, cols, dst, rowStep, colStep, true);
+}
+
+bool Pager::forEachBlock(size_t blockBytes, const BlockVisitor& fn) const
+{
+    auto rows = _rowCount;
+    auto cols = _colCount;
+    auto row_bytes = std::max<size_t>(cols * _data_size, 1);
+    auto block_rows = std::max<size_t>(blockBytes / row_bytes, 1);
+    auto block_cols = row_bytes > blockBytes ? std::max<size_t>(blockBytes / _data_size, 1) : cols;
+    if(!_chunk_dims.empty() && _slice.rowAxis >= 0 && _slice.rowStep == 1)
+    {
+        // 块按chunk的行对齐，一个chunk不会因为跨两块被解压两次
+        auto chunk_rows = (size_t)_chunk_dims[_slice.rowAxis];
+        if(block_rows > chunk_rows) block_rows -= block_rows % chunk_rows;
+    }
+    std::vector<uint8_t> buffer(std::min(block_rows, rows) * std::min(block_cols, cols) * _data_size);
+
+    for(size_t page=0; page<pageCount(); page++)
+    {
+        for(size_t row=0; row<rows; row+=block_rows)
+        {
+            auto n_rows = std::min(block_rows, rows - row);
+            for(size_t col=0; col<cols; col+=block_cols)
+            {
+                auto n_cols = std::min(block_cols, cols - col);
+                auto count = n_rows * n_cols;
+                readSelected(page, row, col, n_rows, n_cols, buffer.data(), 1, 1, false);
+                bool next;
+                try {
+                    next = fn(buffer.data(), page, row, col, n_rows, n_cols);
+                }
+                catch(...) {
+                    reclaim(buffer.data(), count);
+                    throw;
+                }
+                reclaim(buffer.data(), count);
+                if(!next) return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Pager::readSelected(size_t pageIdx, size_t row, size_t col, size_t rows, size_t cols, void* dst, size_t rowStep, size_t colStep, bool cached) const
+{
+    H5Lock lock(hdf5Mutex());
+    auto file_space = _dataset->getSpace();
+    auto rank = _dims.size();
+    if(rank > 0) // 标量数据集没有hyperslab，直接整体读取
+    {
+        // 高维度固定为该页的下标，行、列维度按步长选中指定的块
+        std::vector<hsize_t> offset(rank, 0);
+        std::vector<hsize_t> stride(rank, 1);
+        std::vector<hsize_t> count(rank, 1);
+        auto hidim = getHiDimByPage(pageIdx);
+        for(size_t i=0; i<_page_axes.size(); i++) offset[_page_axes[i]] = hidim[i];
+        offset[_slice.colAxis] = col * _slice.colStep;
+        stride[_slice.colAxis] = _slice.colStep * colStep;
+        count[_slice.colAxis] = cols;
+        if(_slice.rowAxis >= 0)
+        {
+            offset[_slice.rowAxis] = row * _slice.rowStep;
+            stride[_slice.rowAxis] = _slice.rowStep * rowStep;
+            count[_slice.rowAxis] = rows;
+        }
+        if(!_chunk_dims.empty())
+        {
+            readBlockChunked(offset, stride, count, dst, cached);
+            return;
+        }
+        if(H5Sselect_hyperslab(file_space.getId(), H5S_SELECT_SET, offset.data(), stride.data(), count.data(), nullptr) < 0)
+        {
+            throw HighFive::DataSpaceException("Unable to select page hyperslab");
+        }
+    }
+
+    // HDF5按文件里的维度顺序填充，行维度在后面时读出来的是cols×rows，只把这一块转置
+    bool transpose = rank > 0 && _slice.transposed() && rows > 1 && cols > 1;
+    std::vector<uint8_t> block(transpose ? rows * cols * _data_size : 0);
+    HighFive::DataSpace mem_space(std::vector<size_t>{rows * cols});
+    if(H5Dread(readId(), memTypeId(), mem_space.getId(), file_space.getId(), H5P_DEFAULT, transpose ? block.data() : dst) < 0)
+    {
+        throw HighFive::DataSetException("Unable to read page " + std::to_string(pageIdx));
+    }
+    if(transpose) transposeBlock(block.data(), (uint8_t*)dst, rows, cols, _data_size);
+}
+
+bool Pager::isVarLen() const
+{
+    return _vlen;
+}
+
+size_t Pager::tileBytes() const
+{
+    std::lock_guard<std::mutex> lock(_tile_mutex);
+    size_t bytes = 0;
+    for(auto& tile : _tiles) bytes += tile->data.size();
+    return bytes;
+}
+
+void Pager::reclaim(void* data, size_t count) const
+{
+    // 整块一次释放，不按元素释放
+    if(!_vlen || !data || count == 0) return;
+    H5Lock lock(hdf5Mutex());
+    HighFive::DataSpace space(std::vector<size_t>{count});
+    H5Treclaim(memTypeId(), space.getId(), H5P_DEFAULT, data);
+}
+
+std::string Pager::chunkKey(const std::vector<hsize_t>& coord) const
+{
+    std::string key = _chunk_key;
+    for(auto c : coord) key += "," + std::to_string(c);
+    return key;
+}
+
+ChunkCache::Chunk Pager::loadChunk(const std::vector<hsize_t>& coord, bool cached) const
+{
+    // 读取整个chunk（边上的chunk截到数据集范围内），HDF5只解压一次
+    auto rank = _dims.size();
+    std::vector<hsize_t> start(rank), count(rank);
+    for(size_t d=0; d<rank; d++)
+    {
+        start[d] = coord[d] * _chunk_dims[d];
+        count[d] = std::min<hsize_t>(_chunk_dims[d], _dims[d] - start[d]);
+    }
+    auto elements = std::accumulate(count.begin(), count.end(), size_t{1u}, std::multiplies<size_t>());
+    auto data = std::make_shared<std::vector<uint8_t>>(elements * _data_size);
+
+    auto file_space = _dataset->getSpace();
+    if(H5Sselect_hyperslab(file_space.getId(), H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr) < 0)
+    {
+        throw HighFive::DataSpaceException("Unable to select chunk hyperslab");
+    }
+    HighFive::DataSpace mem_space(std::vector<size_t>{elements});
+    if(H5Dread(readId(), memTypeId(), mem_space.getId(), file_space.getId(), H5P_DEFAULT, data->data()) < 0)
+    {
+        throw HighFive::DataSetException("Unable to read chunk");
+    }
+    if(cached) ChunkCache::instance().insert(chunkKey(coord), data);
+    return data;
+}
+
+void Pager::inflateChunks(const std::vector<std::vector<hsize_t>>& coords, const std::vector<size_t>& missing, std::vector<ChunkCache::Chunk>& chunks, bool cached) const
+{
+    // 原始chunk只能一个一个从文件读（要拿HDF5的锁），解压不需要HDF5，分给线程池同时做
+    struct Job
+    {
+        size_t idx;
+        std::vector<uint8_t> raw;
+        uint32_t mask;
+    };
+    auto rank = _dims.size();
+    std::vector<Job> jobs;
+    for(auto idx : missing)
+    {
+        std::vector<hsize_t> offset(rank);
+        for(size_t d=0; d<rank; d++) offset[d] = coords[idx][d] * _chunk_dims[d];
+        hsize_t bytes = 0;
+        herr_t err = -1;
+        // 没分配的chunk读出来是填充值，留给H5Dread；这种情况HDF5会报错，不要打印出来
+        H5E_BEGIN_TRY {
+            err = H5Dget_chunk_storage_size(readId(), offset.data(), &bytes);
+        } H5E_END_TRY;
+        if(err < 0 || bytes == 0) continue;
+        Job job{idx, std::vector<uint8_t>(bytes), 0};
+        if(H5Dread_chunk(readId(), H5P_DEFAULT, offset.data(), &job.mask, job.raw.data()) < 0) continue;
+        jobs.push_back(std::move(job));
+    }
+    if(jobs.empty()) return;
+
+    auto full_bytes = std::accumulate(_chunk_dims.begin(), _chunk_dims.end(), size_t{1u}, std::multiplies<size_t>()) * _data_size;
+    parallelFor(inflatePool(), jobs.size(), [&](size_t i){
+        // 解不出来的chunk保持为空，后面用H5Dread重新读，结果和串行读取一样
+        auto& job = jobs[i];
+        if(decodeChunk(job.raw, _filters, job.mask, full_bytes, _data_size))
+        {
+            chunks[job.idx] = cropChunk(coords[job.idx], job.raw);
+        }
+    });
+
+    if(!cached) return;
+    for(auto& job : jobs)
+    {
+        if(chunks[job.idx]) ChunkCache::instance().insert(chunkKey(coords[job.idx]), chunks[job.idx]);
+    }
+}
+
+ChunkCache::Chunk Pager::cropChunk(const std::vector<hsize_t>& coord, std::vector<uint8_t>& full) const
+{
+    // H5Dread_chunk读出的边上chunk也是完整大小，截到数据集范围内，和loadChunk的结果一致
+    auto rank = _dims.size();
+    std::vector<hsize_t> count(rank);
+    for(size_t d=0; d<rank; d++) count[d] = std::min<hsize_t>(_chunk_dims[d], _dims[d] - coord[d] * _chunk_dims[d]);
+    if(count == _chunk_dims) return std::make_shared<std::vector<uint8_t>>(std::move(full));
+
+    auto elements = std::accumulate(count.begin(), count.end(), size_t{1u}, std::multiplies<size_t>());
+    auto data = std::make_shared<std::vector<uint8_t>>(elements * _data_size);
+    auto line = count[rank-1] * _data_size;
+    std::vector<hsize_t> idx(rank, 0);
+    for(size_t n=0; n<elements / count[rank-1]; n++)
+    {
+        size_t src = 0;
+        for(size_t d=0; d+1<rank; d++) src = (src + idx[d]) * _chunk_dims[d+1];
+        memcpy(data->data() + n * line, full.data() + src * _data_size, line);
+        for(size_t d=rank-1; d>0; d--)
+        {
+            if(++idx[d-1] < count[d-1]) break;
+            idx[d-1] = 0;
+        }
+    }
+    return data;
+}
+
+void Pager::readBlockChunked(const std::vector<hsize_t>& start, const std::vector<hsize_t>& stride, const std::vector<hsize_t>& count, void* dst, bool cached) const
+{
+    // 按chunk网格逐个chunk复制选中的元素，跳着取时没有选中元素的chunk不读
+    auto rank = _dims.size();
+    auto cols = count[_slice.colAxis];
+    auto selected = [&](size_t d, hsize_t c, hsize_t& k0, hsize_t& k1){
+        // chunk c在第d维里选中的是start+k*stride，k在[k0,k1)
+        auto lo = c * _chunk_dims[d];
+        auto hi = std::min<hsize_t>(lo + _chunk_dims[d], start[d] + (count[d] - 1) * stride[d] + 1);
+        k0 = lo > start[d] ? (lo - start[d] + stride[d] - 1) / stride[d] : 0;
+        k1 = hi > start[d] ? std::min<hsize_t>((hi - start[d] + stride[d] - 1) / stride[d], count[d]) : 0;
+        return k0 < k1;
+    };
+
+    std::vector<std::vector<hsize_t>> axis_chunks(rank);
+    for(size_t d=0; d<rank; d++)
+    {
+        hsize_t k0, k1;
+        auto last = (start[d] + (count[d] - 1) * stride[d]) / _chunk_dims[d];
+        for(auto c = start[d] / _chunk_dims[d]; c <= last; c++)
+        {
+            if(selected(d, c, k0, k1)) axis_chunks[d].push_back(c);
+        }
+    }
+
+    std::vector<std::vector<hsize_t>> coords;
+    std::vector<size_t> pos(rank, 0);
+    while(true)
+    {
+        std::vector<hsize_t> coord(rank);
+        for(size_t d=0; d<rank; d++) coord[d] = axis_chunks[d][pos[d]];
+        coords.push_back(std::move(coord));
+        size_t d = rank;
+        while(d > 0)
+        {
+            d--;
+            if(++pos[d] < axis_chunks[d].size()) break;
+            pos[d] = 0;
+        }
+        if(std::all_of(pos.begin(), pos.end(), [](auto p){ return p == 0; })) break;
+    }
+
+    auto& cache = ChunkCache::instance();
+    std::vector<ChunkCache::Chunk> chunks(coords.size());
+    std::vector<size_t> missing;
+    for(size_t i=0; i<coords.size(); i++)
+    {
+        if(cached) chunks[i] = cache.find(chunkKey(coords[i]));
+        if(!chunks[i]) missing.push_back(i);
+    }
+    if(_raw_chunks && missing.size() > 1) inflateChunks(coords, missing, chunks, cached);
+    for(auto i : missing)
+    {
+        if(!chunks[i]) chunks[i] = loadChunk(coords[i], cached);
+    }
+
+    auto row_axis = _slice.rowAxis;
+    auto col_axis = (size_t)_slice.colAxis;
+    // 列维度是最后一维并且不跳着取时，一行在chunk里是连续的
+    bool contiguous = col_axis == rank - 1 && stride[col_axis] == 1;
+    for(size_t i=0; i<coords.size(); i++)
+    {
+        auto& coord = coords[i];
+        auto& chunk = chunks[i];
+
+        std::vector<hsize_t> cstart(rank), k0(rank), k1(rank);
+        std::vector<size_t> cstride(rank, 1);
+        for(size_t d=0; d<rank; d++)
+        {
+            cstart[d] = coord[d] * _chunk_dims[d];
+            selected(d, coord[d], k0[d], k1[d]);
+        }
+        for(size_t d=rank-1; d>0; d--) cstride[d-1] = cstride[d] * std::min<hsize_t>(_chunk_dims[d], _dims[d] - cstart[d]);
+
+        size_t base = 0; // 高维度在chunk里的偏移
+        for(size_t d=0; d<rank; d++)
+        {
+            if((int)d != row_axis && d != col_axis) base += (start[d] - cstart[d]) * cstride[d];
+        }
+
+        hsize_t row_k0 = row_axis >= 0 ? k0[row_axis] : 0;
+        hsize_t row_k1 = row_axis >= 0 ? k1[row_axis] : 1;
+        for(hsize_t r=row_k0; r<row_k1; r++)
+        {
+            size_t src = base;
+            if(row_axis >= 0) src += (start[row_axis] + r * stride[row_axis] - cstart[row_axis]) * cstride[row_axis];
+            auto out = (uint8_t*)dst + (r * cols + k0[col_axis]) * _data_size;
+            if(contiguous)
+            {
+                src += start[col_axis] + k0[col_axis] - cstart[col_axis];
+                memcpy(out, chunk->data() + src * _data_size, (k1[col_axis] - k0[col_axis]) * _data_size);
+                continue;
+            }
+            for(auto c=k0[col_axis]; c<k1[col_axis]; c++, out += _data_size)
+            {
+                auto idx = src + (start[col_axis] + c * stride[col_axis] - cstart[col_axis]) * cstride[col_axis];
+                memcpy(out, chunk->data() + idx * _data_size, _data_size);
+            }
+        }
+    }
+}
+
+std::span<const uint8_t> Pager::getPageData(size_t pageIdx)
+{
+    if(pageIdx >= pageCount()) return {};
+    auto bytePerPage = _data_size * _colCount * _rowCount;
+    if(_mapped && isDefaultSlice())
+    {
+        return std::span<const uint8_t>(_mapped + bytePerPage * pageIdx, bytePerPage);
+    }
+    if(pageIdx != _page_idx)
+    {
+        if(_page_idx != SIZE_MAX) reclaim(_page_buffer.data(), _page_buffer.size() / _data_size);
+        _page_idx = SIZE_MAX;
+        _page_buffer.assign(_data_size * _colCount * _rowCount, 0);
+        readBlock(pageIdx, 0, 0, _rowCount, _colCount, _page_buffer.data());
+        _page_idx = pageIdx;
+    }
+    return std::span<const uint8_t>(_page_buffer.data(), _page_buffer.size());
+}
+
+std::shared_ptr<const uint8_t> Pager::getCell(size_t pageIdx, size_t row, size_t col)
+{
+    if(pageIdx >= pageCount() || row >= _rowCount || col >= _colCount) return nullptr;
+    if(_mapped)
+    {
+        return std::shared_ptr<const uint8_t>(_map_file, _mapped + elementIndex(pageIdx, row, col) * _data_size);
+    }
+
+    auto tileRow = row / _tile_rows;
+    auto tileCol = col / _tile_cols;
+    auto findTile = [&]() -> std::shared_ptr<Tile> {
+        std::lock_guard<std::mutex> lock(_tile_mutex);
+        auto itr = std::find_if(_tiles.begin(), _tiles.end(), [&](const auto& t){
+            return t->page == pageIdx && t->tileRow == tileRow && t->tileCol == tileCol;
+        });
+        if(itr == _tiles.end()) return nullptr;
+        _tiles.splice(_tiles.begin(), _tiles, itr);
+        return _tiles.front();
+    };
+
+    auto tile = findTile();
+    if(!tile)
+    {
+        auto row0 = tileRow * _tile_rows;
+        auto col0 = tileCol * _tile_cols;
+        auto rows = std::min(_tile_rows, _rowCount - row0);
+        auto cols = std::min(_tile_cols, _colCount - col0);
+        tile = std::make_shared<Tile>(Tile{pageIdx, tileRow, tileCol, cols, std::vector<uint8_t>(rows * cols * _data_size)});
+        readBlock(pageIdx, row0, col0, rows, cols, tile->data.data());
+        if(_vlen)
+        {
+            // 块可能比Pager活得久，也可能在后台线程里最后释放，用类型的副本
+            H5Lock lock(hdf5Mutex());
+            auto count = rows * cols;
+            tile->arena = std::shared_ptr<void>(tile->data.data(), [type = H5Tcopy(memTypeId()), count](void* p){
+                H5Lock lock(hdf5Mutex());
+                HighFive::DataSpace space(std::vector<size_t>{count});
+                H5Treclaim(type, space.getId(), H5P_DEFAULT, p);
+                H5Tclose(type);
+            });
+        }
+
+        // 挤出去的块在放开_tile_mutex以后再释放，释放变长数据要拿HDF5的锁
+        std::shared_ptr<Tile> evicted;
+        std::lock_guard<std::mutex> lock(_tile_mutex);
+        _tiles.push_front(tile);
+        if(_tiles.size() > (_vlen ? VLEN_TILE_CACHE_SIZE : TILE_CACHE_SIZE))
+        {
+            evicted = std::move(_tiles.back());
+            _tiles.pop_back();
+        }
+    }
+
+    auto r = row % _tile_rows;
+    auto c = col % _tile_cols;
+    return std::shared_ptr<const uint8_t>(tile, &tile->data[(r * tile->cols + c) * _data_size]);
 }
\ No newline at end of file
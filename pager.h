@@ -1,25 +1,134 @@
 #ifndef PAGER_H
 #define PAGER_H
 
+#include <mutex>
+#include <QFile>
+#include "chunkcache.h"
+
+// 按页从数据集中读取数据，每一页用一次hyperslab只读取该页，不再一次性读取整个数据集
+// getCell可以在后台线程调用，读取时会拿HDF5的锁
+// 连续存储、没有过滤器的数据集直接把文件映射到内存，getCell/getPageData返回指向映射区的指针，不再复制
+// chunk存储的数据集按chunk读取，解压后的chunk放在ChunkCache里，表格块按chunk对齐
+// 一次要读多个chunk时，gzip压缩的chunk读出原始数据后在线程池里并行解压
+// 页的行、列维度和步长
+struct PageSlice
+{
+    int rowAxis{-1}; // 按HDF5的维度顺序，-1表示默认的低2维度；1维数据集没有行维度
+    int colAxis{-1};
+    size_t rowStep{1};
+    size_t colStep{1};
+    bool operator==(const PageSlice&) const = default;
+    bool transposed() const { return rowAxis > colAxis; } // 行维度在列维度后面：MATLAB的顺序
+    PageSlice swapped() const { return {colAxis, rowAxis, colStep, rowStep}; }
+};
+
+// 按matlabOrder摆好行、列维度，没指定时是低2维；只是交换行、列维度，数据不转置；1维的没有行维度
+PageSlice viewSlice(PageSlice slice, size_t rank, bool matlabOrder);
+// src是cols×rows，转置到dst（rows×cols），分成小块复制，两边都尽量在缓存里
+void transposeBlock(const uint8_t* src, uint8_t* dst, size_t rows, size_t cols, size_t size);
+
+// 表格的行、列可以选任意两个维度，还可以隔几个取一个，一次hyperslab只读需要的元素
+// 行维度在列维度后面时就是转置的视图（MATLAB按列存储，按这个顺序看才和MATLAB里一样），数据不复制：
+// 映射和chunk缓存本来就按下标取元素，直接读取时只把读出来的这一块按块转置
+// compound类型可以只读其中几个成员（fields），不能映射时用只含这些成员的内存类型读取，HDF5只转换选中的成员
+// 变长字符串、VLEN读出来的是HDF5分配的指针：每个表格块整块读取，块被挤出缓存时一次H5Treclaim全部释放，
+// 单元格直接指向这块内存，不复制；readBlock读出来的块要调用reclaim
 class Pager
 {
 public:
-    Pager(std::vector<uint8_t> buffer, const std::vector<hsize_t>& dims, size_t data_size);
+    using Member = HighFive::CompoundType::member_def;
+
+    // fields为空时读取所有成员；只读部分成员时dataSize()是内存里的元素大小，不再是data_size
+    Pager(const HighFive::DataSet& dataset, const std::vector<size_t>& dims, size_t data_size, PageSlice slice = {}, std::vector<std::string> fields = {});
+    ~Pager();
+    // 拥有HDF5的句柄和页缓存，不能复制，用shared_ptr共享
+    Pager(const Pager&) = delete;
+    Pager& operator=(const Pager&) = delete;
 
     size_t columnCount() const;
     size_t rowCount() const;
 
     size_t pageCount() const;
     size_t dataSize() const;
-    std::vector<size_t> getHiDimByPage(size_t) const; // 得到指定页的高维度（低2维度当作表格）
+    std::vector<size_t> getHiDimByPage(size_t) const; // 得到指定页的高维度（行、列以外的维度）
+    size_t getPageByHiDim(const std::vector<size_t>&) const; // getHiDimByPage的反过程，越界返回SIZE_MAX
+    const std::vector<size_t>& hiDims() const;
+    const std::vector<size_t>& pageAxes() const; // 高维度各是数据集的第几维
+    const std::vector<size_t>& dims() const;
+    const PageSlice& slice() const; // 实际使用的行、列维度
+    const std::vector<std::string>& fields() const; // 构造时指定的成员
+    const std::vector<Member>& members() const; // 读出来的元素里各成员的位置，不是compound类型时为空
 
-    std::span<uint8_t> getPageData(size_t);
+    std::span<const uint8_t> getPageData(size_t); // 只读取指定页，结果缓存到下次换页，只能在一个线程里用
+    bool isMapped() const;
+    // 按块读取，只读取单元格所在的块。返回的指针会让所在的块一直有效
+    std::shared_ptr<const uint8_t> getCell(size_t pageIdx, size_t row, size_t col);
+    // 直接读取一块到dst（rows×cols），不经过表格块缓存，导出时用
+    // rowStep、colStep按页里的行、列隔几个取一个，预览缩小时用
+    void readBlock(size_t pageIdx, size_t row, size_t col, size_t rows, size_t cols, void* dst, size_t rowStep = 1, size_t colStep = 1) const;
+    // 按页、行、列的顺序一块一块读完整个数据集，统计、导出用；一块是若干整行，一行比块还大时分成几块
+    // 不放进ChunkCache，不会挤掉表格正在用的chunk；fn返回false时停止，返回值表示是否读完
+    // 块里的变长数据在fn返回后释放
+    using BlockVisitor = std::function<bool(const uint8_t* data, size_t page, size_t row, size_t col, size_t rows, size_t cols)>;
+    bool forEachBlock(size_t blockBytes, const BlockVisitor& fn) const;
+    bool isVarLen() const; // 元素里有HDF5分配的内存
+    size_t tileBytes() const; // 缓存的表格块占的字节数，映射的数据集为0
+    void reclaim(void* data, size_t count) const; // 释放readBlock读出来的count个元素里的变长数据，定长类型什么都不做
 private:
-    std::vector<uint8_t> _buffer;
+    struct Tile
+    {
+        size_t page;
+        size_t tileRow;
+        size_t tileCol;
+        size_t cols;
+        std::vector<uint8_t> data;
+        std::shared_ptr<void> arena; // 有变长数据时，在data之前析构，一次H5Treclaim释放整块
+    };
+    // cached为false时不查也不放进ChunkCache
+    void readSelected(size_t pageIdx, size_t row, size_t col, size_t rows, size_t cols, void* dst, size_t rowStep, size_t colStep, bool cached) const;
+    void readBlockChunked(const std::vector<hsize_t>& start, const std::vector<hsize_t>& stride, const std::vector<hsize_t>& count, void* dst, bool cached) const;
+    ChunkCache::Chunk loadChunk(const std::vector<hsize_t>& coord, bool cached) const;
+    void inflateChunks(const std::vector<std::vector<hsize_t>>& coords, const std::vector<size_t>& missing, std::vector<ChunkCache::Chunk>& chunks, bool cached) const;
+    ChunkCache::Chunk cropChunk(const std::vector<hsize_t>& coord, std::vector<uint8_t>& full) const;
+    std::string chunkKey(const std::vector<hsize_t>& coord) const;
+    bool isDefaultSlice() const;
+    size_t elementIndex(size_t pageIdx, size_t row, size_t col) const;
+    void tryMap();
+    void initChunks();
+    void initMembers();
+    hid_t readId() const;
+    hid_t memTypeId() const;
+
+    std::optional<HighFive::DataSet> _dataset;
+    std::optional<HighFive::DataType> _data_type;
+    std::vector<size_t> _dims;
     std::vector<size_t> _hi_dims;
+    std::vector<size_t> _page_axes;
+    PageSlice _slice;
     size_t _colCount{1};
     size_t _rowCount{1};
     size_t _data_size;
+    std::vector<std::string> _fields;
+    std::vector<Member> _members;
+    hid_t _mem_type{H5I_INVALID_HID}; // 只含选中成员的compound类型，为空时按文件里的类型读取
+
+    bool _vlen{false};
+
+    std::vector<uint8_t> _page_buffer;
+    size_t _page_idx{SIZE_MAX};
+    std::list<std::shared_ptr<Tile>> _tiles; // 最近使用的块在前面
+    mutable std::mutex _tile_mutex;
+
+    std::shared_ptr<QFile> _map_file; // 映射区随QFile一起释放
+    const uint8_t* _mapped{nullptr};
+
+    size_t _tile_rows;
+    size_t _tile_cols;
+    std::vector<hsize_t> _chunk_dims; // 为空表示不走chunk缓存
+    std::string _chunk_key; // 在ChunkCache里区分数据集
+    hid_t _read_id{H5I_INVALID_HID}; // 按chunk大小设置了HDF5 chunk cache后重新打开的数据集
+    std::vector<H5Z_filter_t> _filters; // 写入时的过滤器顺序
+    bool _raw_chunks{false}; // 只用了deflate/shuffle，可以用H5Dread_chunk读原始chunk后并行解压
 };
 
 #endif
\ No newline at end of file
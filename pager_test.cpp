@@ -0,0 +1,169 @@
+#include "prefix.h"
+#include "pager.h"
+#include "helper.h"
+#include <QTemporaryDir>
+#include <QtTest>
+
+// MATLAB的顺序只交换行、列维度；转置的页读出来和按下标取的一样
+class PagerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void defaultSlice()
+    {
+        QCOMPARE(viewSlice({}, 3, false), (PageSlice{1, 2}));
+        QCOMPARE(viewSlice({}, 3, true), (PageSlice{2, 1}));
+        QCOMPARE(viewSlice({}, 1, true), PageSlice{}); // 1维没有行维度
+    }
+
+    void explicitSlice()
+    {
+        PageSlice slice{0, 2, 10, 1};
+        QCOMPARE(viewSlice(slice, 3, false), slice);
+        QCOMPARE(viewSlice(slice, 3, true), (PageSlice{2, 0, 1, 10}));
+        QCOMPARE(viewSlice(viewSlice(slice, 3, true), 3, false), slice);
+        PageSlice columns{-1, 1};
+        QCOMPARE(viewSlice(columns, 2, true), columns); // 没有行维度时不用换
+    }
+
+    void transposeAcrossBlocks()
+    {
+        // 比转置的小块大，边上的块不满
+        constexpr size_t rows = 37, cols = 70;
+        std::vector<uint16_t> src(rows * cols), dst(rows * cols);
+        for(size_t c=0; c<cols; c++)
+            for(size_t r=0; r<rows; r++) src[c * rows + r] = (uint16_t)(r * 1000 + c);
+        transposeBlock((const uint8_t*)src.data(), (uint8_t*)dst.data(), rows, cols, sizeof(uint16_t));
+        for(size_t r=0; r<rows; r++)
+            for(size_t c=0; c<cols; c++) QCOMPARE(dst[r * cols + c], (uint16_t)(r * 1000 + c));
+    }
+
+    void transposedPage()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        HighFive::File file(dir.filePath("page.h5").toStdString(), HighFive::File::Truncate);
+        std::vector<std::vector<int>> values(5, std::vector<int>(40));
+        for(size_t i=0; i<values.size(); i++)
+            for(size_t j=0; j<values[i].size(); j++) values[i][j] = (int)(i * 100 + j);
+        auto dataset = file.createDataSet<int>("m", HighFive::DataSpace::From(values));
+        dataset.write(values);
+
+        std::vector<size_t> dims{5, 40};
+        Pager pager(dataset, dims, sizeof(int), viewSlice({}, dims.size(), true));
+        QCOMPARE(pager.rowCount(), (size_t)40);
+        QCOMPARE(pager.columnCount(), (size_t)5);
+        QCOMPARE(*(const int*)pager.getCell(0, 7, 3).get(), 307);
+
+        std::vector<int> block(3 * 2);
+        pager.readBlock(0, 10, 1, 3, 2, block.data());
+        QCOMPARE(block, (std::vector<int>{110, 210, 111, 211, 112, 212}));
+    }
+
+    void varLenTiles()
+    {
+        // 300个变长字符串，跨两个表格块；块里的字符串是HDF5分配的，读到的指针在块释放前有效
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        HighFive::File file(dir.filePath("strings.h5").toStdString(), HighFive::File::Truncate);
+        std::vector<std::string> texts;
+        std::vector<const char*> ptrs;
+        for(int i=0; i<300; i++) texts.push_back("s" + std::to_string(i));
+        for(auto& t : texts) ptrs.push_back(t.c_str());
+        MyType str(H5Tcopy(H5T_C_S1));
+        H5Tset_size(str.getId(), H5T_VARIABLE);
+        hsize_t n = texts.size();
+        hid_t space = H5Screate_simple(1, &n, nullptr);
+        hid_t ds = H5Dcreate2(file.getId(), "strings", str.getId(), space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Dwrite(ds, str.getId(), H5S_ALL, H5S_ALL, H5P_DEFAULT, ptrs.data());
+        H5Dclose(ds);
+        H5Sclose(space);
+
+        auto dataset = file.getDataSet("strings");
+        auto type = dataset.getDataType();
+        auto vlen = selectVlenFormat(type);
+        Pager pager(dataset, {texts.size()}, type.getSize());
+        QVERIFY(pager.isVarLen());
+        QVERIFY(!pager.isMapped());
+        auto first = pager.getCell(0, 0, 1);
+        QCOMPARE(formatVlen(pager.getCell(0, 0, 299).get(), vlen), QString("s299"));
+        QCOMPARE(vlenView(first.get(), vlen), std::string_view("s1"));
+
+        std::vector<uint8_t> block(3 * type.getSize());
+        pager.readBlock(0, 0, 10, 1, 3, block.data());
+        QCOMPARE(formatVlen(block.data() + type.getSize(), vlen), QString("s11"));
+        pager.reclaim(block.data(), 3);
+    }
+
+    void compressedChunks()
+    {
+        // shuffle+gzip压缩，边上的chunk不满；并行解压、chunk缓存读出来的要和H5Dread一样
+        if(H5Zfilter_avail(H5Z_FILTER_DEFLATE) <= 0) QSKIP("gzip filter not available");
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        HighFive::File file(dir.filePath("chunks.h5").toStdString(), HighFive::File::Truncate);
+        constexpr size_t pages = 3, rows = 50, cols = 70;
+        std::vector<int> values(pages * rows * cols);
+        for(size_t i=0; i<values.size(); i++) values[i] = (int)(i * 2654435761u >> 7);
+        hsize_t dims[3] = {pages, rows, cols};
+        hsize_t chunk[3] = {2, 16, 24};
+        hid_t space = H5Screate_simple(3, dims, nullptr);
+        hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+        H5Pset_chunk(dcpl, 3, chunk);
+        H5Pset_shuffle(dcpl);
+        H5Pset_deflate(dcpl, 6);
+        hid_t ds = H5Dcreate2(file.getId(), "m", H5T_NATIVE_INT, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        H5Dwrite(ds, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data());
+        H5Dclose(ds);
+        H5Pclose(dcpl);
+        H5Sclose(space);
+
+        auto dataset = file.getDataSet("m");
+        auto expected = [&](size_t page, size_t row, size_t col, size_t n_rows, size_t n_cols, size_t row_step, size_t col_step){
+            std::vector<int> out(n_rows * n_cols);
+            hsize_t offset[3] = {page, row, col};
+            hsize_t stride[3] = {1, row_step, col_step};
+            hsize_t count[3] = {1, n_rows, n_cols};
+            hsize_t n = out.size();
+            hid_t file_space = H5Dget_space(dataset.getId());
+            hid_t mem_space = H5Screate_simple(1, &n, nullptr);
+            H5Sselect_hyperslab(file_space, H5S_SELECT_SET, offset, stride, count, nullptr);
+            H5Dread(dataset.getId(), H5T_NATIVE_INT, mem_space, file_space, H5P_DEFAULT, out.data());
+            H5Sclose(mem_space);
+            H5Sclose(file_space);
+            return out;
+        };
+
+        Pager pager(dataset, {pages, rows, cols}, sizeof(int));
+        QVERIFY(!pager.isMapped());
+        for(int pass=0; pass<2; pass++) // 第二遍从chunk缓存里取
+        {
+            for(size_t page=0; page<pages; page++)
+            {
+                std::vector<int> block(rows * cols);
+                pager.readBlock(page, 0, 0, rows, cols, block.data());
+                QCOMPARE(block, expected(page, 0, 0, rows, cols, 1, 1));
+            }
+        }
+
+        // 从边上的chunk中间开始，跨过chunk边界
+        std::vector<int> block(20 * 30);
+        pager.readBlock(2, 30, 40, 20, 30, block.data());
+        QCOMPARE(block, expected(2, 30, 40, 20, 30, 1, 1));
+        std::vector<int> strided(9 * 13);
+        pager.readBlock(1, 3, 5, 9, 13, strided.data(), 5, 5);
+        QCOMPARE(strided, expected(1, 3, 5, 9, 13, 5, 5));
+
+        // 不经过chunk缓存的整块遍历
+        std::vector<int> all;
+        QVERIFY(pager.forEachBlock(20 * cols * sizeof(int), [&](const uint8_t* data, size_t, size_t, size_t, size_t n_rows, size_t n_cols){
+            all.insert(all.end(), (const int*)data, (const int*)data + n_rows * n_cols);
+            return true;
+        }));
+        QCOMPARE(all, values);
+    }
+};
+
+QTEST_GUILESS_MAIN(PagerTest)
+#include "pager_test.moc"
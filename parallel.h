@@ -0,0 +1,38 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QThreadPool>
+#include <latch>
+
+// 在线程池里同时执行fn(0)...fn(n-1)，全部完成后才返回。fn不能抛出异常；不要在同一个线程池的线程里调用
+inline void parallelFor(QThreadPool& pool, size_t n, const std::function<void(size_t)>& fn)
+{
+    class Runnable : public QRunnable
+    {
+    public:
+        explicit Runnable(std::function<void()> run)
+        : _run(std::move(run))
+        {
+        }
+
+        void run() override
+        {
+            _run();
+        }
+
+    private:
+        std::function<void()> _run;
+    };
+
+    std::latch done((std::ptrdiff_t)n);
+    for(size_t i=0; i<n; i++)
+    {
+        pool.start(new Runnable([&fn, &done, i]{
+            fn(i);
+            done.count_down();
+        }));
+    }
+    done.wait();
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include "prefix.h"
+#include "pathsearch.h"
+#include "metaindex.h"
+#include "parallel.h"
+#include <stdexcept>
+
+namespace
+{
+    constexpr size_t LINES_PER_CHUNK = 16384;
+
+    void toLowerAscii(std::string& s)
+    {
+        // UTF-8的多字节字符都大于0x7f，不受影响
+        for(auto& c : s)
+        {
+            if(c >= 'A' && c <= 'Z') c = char(c - 'A' + 'a');
+        }
+    }
+
+    std::string_view baseName(std::string_view path)
+    {
+        auto slash = path.rfind('/');
+        return slash == std::string_view::npos ? path : path.substr(slash + 1);
+    }
+
+    // 通配符转成正则表达式，同时找出最长的字面片段用来筛选
+    QString globToRegex(const QString& glob, std::string& literal)
+    {
+        QString re;
+        std::string run;
+        auto flush = [&]{
+            if(run.size() > literal.size()) literal = run;
+            run.clear();
+        };
+        for(auto c : glob)
+        {
+            if(c == '*')
+            {
+                flush();
+                re += ".*";
+            }
+            else if(c == '?')
+            {
+                flush();
+                re += ".";
+            }
+            else
+            {
+                re += QRegularExpression::escape(QString(c));
+                run += QString(c).toUtf8().toStdString();
+            }
+        }
+        flush();
+        return "^" + re + "$";
+    }
+}
+
+PathSearch::PathSearch(std::shared_ptr<const MetaIndex> index)
+: _index(std::move(index))
+{
+    // 节点按层次排列，父节点总在子节点前面，路径可以由父节点的那一行拼出来
+    // 父节点可能就是上一个节点，它的下一行还没开始，行的长度要在加入时记下来
+    auto n = _index->size();
+    std::vector<size_t> lengths(n, 0);
+    _offsets.reserve(n + 1);
+    _text.reserve(n * 32);
+    _offsets.push_back(0);
+    _text += '\n'; // 根节点
+    for(uint32_t i=1; i<n; i++)
+    {
+        auto start = _text.size();
+        auto p = _index->parent(i);
+        if(p >= i) throw std::invalid_argument("Invalid index: parent after child");
+        auto len = lengths[p];
+        _text.resize(start + len);
+        memcpy(&_text[start], &_text[_offsets[p]], len);
+        _text += '/';
+        std::string name(_index->name(i));
+        toLowerAscii(name);
+        _text += name;
+        lengths[i] = _text.size() - start;
+        _text += '\n';
+        _offsets.push_back(start);
+    }
+    _offsets.push_back(_text.size());
+}
+
+size_t PathSearch::size() const
+{
+    return _offsets.size() - 1;
+}
+
+std::string_view PathSearch::line(size_t node) const
+{
+    return std::string_view(_text).substr(_offsets[node], _offsets[node + 1] - _offsets[node] - 1);
+}
+
+std::vector<uint32_t> PathSearch::scan(std::string_view literal, const std::function<bool(std::string_view)>& accept,
+    size_t limit, const std::function<bool()>& cancelled) const
+{
+    // 分段并行，每段最多找limit个，合并后按顺序截断
+    auto lines = size();
+    auto chunks = (lines + LINES_PER_CHUNK - 1) / LINES_PER_CHUNK;
+    std::vector<std::vector<uint32_t>> hits(chunks);
+    std::atomic<bool> stop{false};
+    std::boyer_moore_horspool_searcher searcher(literal.begin(), literal.end());
+    parallelFor(*QThreadPool::globalInstance(), chunks, [&](size_t c){
+        if(stop || (cancelled && cancelled())) { stop = true; return; }
+        auto& out = hits[c];
+        auto first = c * LINES_PER_CHUNK;
+        auto last = std::min(first + LINES_PER_CHUNK, lines);
+        if(literal.empty())
+        {
+            for(auto i=first; i<last && out.size()<limit; i++)
+            {
+                if(i > 0 && accept(line(i))) out.push_back((uint32_t)i);
+            }
+            return;
+        }
+
+        auto end = _text.begin() + _offsets[last];
+        auto pos = _text.begin() + _offsets[first];
+        while(out.size() < limit)
+        {
+            pos = std::search(pos, end, searcher);
+            if(pos == end) break;
+            auto i = size_t(std::upper_bound(_offsets.begin() + first, _offsets.begin() + last, size_t(pos - _text.begin())) - _offsets.begin() - 1);
+            if(i > 0 && accept(line(i))) out.push_back((uint32_t)i);
+            pos = _text.begin() + _offsets[i + 1];
+        }
+    });
+    if(stop) return {};
+
+    std::vector<uint32_t> res;
+    for(auto& h : hits)
+    {
+        res.insert(res.end(), h.begin(), h.end());
+        if(res.size() >= limit) break;
+    }
+    if(res.size() > limit) res.resize(limit);
+    return res;
+}
+
+std::vector<QString> PathSearch::find(const QString& query, size_t limit, const std::function<bool()>& cancelled) const
+{
+    std::vector<uint32_t> nodes;
+    if(query.startsWith("re:"))
+    {
+        QRegularExpression re(query.mid(3), QRegularExpression::CaseInsensitiveOption);
+        if(!re.isValid()) throw std::invalid_argument(re.errorString().toStdString());
+        re.optimize();
+        nodes = scan({}, [&re](std::string_view l){
+            return re.match(QString::fromUtf8(l.data(), (int)l.size())).hasMatch();
+        }, limit, cancelled);
+    }
+    else if(query.contains('*') || query.contains('?'))
+    {
+        std::string literal;
+        QRegularExpression re(globToRegex(query, literal), QRegularExpression::CaseInsensitiveOption);
+        re.optimize();
+        toLowerAscii(literal);
+        auto whole = query.contains('/');
+        // 只匹配名字时，字面片段里没有/，筛选结果还要再看名字
+        nodes = scan(literal, [&re, whole](std::string_view l){
+            auto s = whole ? l : baseName(l);
+            return re.match(QString::fromUtf8(s.data(), (int)s.size())).hasMatch();
+        }, limit, cancelled);
+    }
+    else
+    {
+        auto literal = query.toUtf8().toStdString();
+        toLowerAscii(literal);
+        if(literal.empty()) return {};
+        nodes = scan(literal, [](std::string_view){ return true; }, limit, cancelled);
+    }
+
+    std::vector<QString> res;
+    res.reserve(nodes.size());
+    for(auto node : nodes)
+    {
+        res.push_back(QString::fromStdString(_index->path(node)));
+    }
+    return res;
+}
@@ -0,0 +1,72 @@
+#include "prefix.h"
+#include "pathsearch.h"
+#include "metaindex.h"
+#include <QTemporaryDir>
+#include <QStandardPaths>
+#include <QtTest>
+
+// 在临时目录里建一个嵌套的小文件，建好MetaIndex以后再建搜索索引
+class PathSearchTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true); // 索引写到测试用的缓存目录
+        QVERIFY(_dir.isValid());
+        auto fileName = _dir.filePath("nested.h5");
+        {
+            HighFive::File file(fileName.toStdString(), HighFive::File::Truncate);
+            auto alpha = file.createGroup("Alpha");
+            auto deep = alpha.createGroup("beta").createGroup("gamma").createGroup("delta");
+            std::vector<double> values{1, 2, 3};
+            deep.createDataSet<double>("Needle", HighFive::DataSpace::From(values)).write(values);
+            alpha.createGroup("other");
+            file.createGroup("zeta").createDataSet<double>("hay", HighFive::DataSpace::From(values)).write(values);
+        }
+        HighFive::File file(fileName.toStdString(), HighFive::File::ReadOnly);
+        auto index = MetaIndex::build(file, fileName);
+        QVERIFY(index);
+        _search = std::make_unique<PathSearch>(index);
+    }
+
+    void everyNodeHasALine()
+    {
+        // 根、6个组（Alpha、beta、gamma、delta、other、zeta）、2个数据集
+        QCOMPARE(_search->size(), (size_t)9);
+    }
+
+    void substringFindsDeepPath()
+    {
+        auto res = _search->find("needle", 10);
+        QCOMPARE(res.size(), (size_t)1);
+        QCOMPARE(res[0], QString("/Alpha/beta/gamma/delta/Needle"));
+    }
+
+    void substringMatchesParents()
+    {
+        // 路径里含beta的：beta本身和它下面的所有节点
+        QCOMPARE(_search->find("/beta", 10).size(), (size_t)4);
+    }
+
+    void globMatchesNameOrWholePath()
+    {
+        QCOMPARE(_search->find("ne*", 10), std::vector<QString>{"/Alpha/beta/gamma/delta/Needle"});
+        QCOMPARE(_search->find("/alpha/*/gamma", 10), std::vector<QString>{"/Alpha/beta/gamma"});
+    }
+
+    void regexAndLimit()
+    {
+        QCOMPARE(_search->find("re:^/zeta", 10).size(), (size_t)2);
+        QCOMPARE(_search->find("a", 1).size(), (size_t)1);
+        QVERIFY_EXCEPTION_THROWN(_search->find("re:(", 10), std::invalid_argument);
+    }
+
+private:
+    QTemporaryDir _dir;
+    std::unique_ptr<PathSearch> _search;
+};
+
+QTEST_GUILESS_MAIN(PathSearchTest)
+#include "pathsearch_test.moc"
@@ -0,0 +1,500 @@
+#include "prefix.h"
+#include "plotview.h"
+#include "pager.h"
+#include <QPainter>
+#include <QWheelEvent>
+#include <cmath>
+
+namespace
+{
+    constexpr size_t TILE_2D = 128; // 热图一块每个方向的格子个数
+    constexpr size_t TILE_1D = 2048;
+    constexpr size_t SAMPLES_2D = 4; // 每个格子每个方向最多采样的元素个数
+    constexpr size_t SAMPLES_1D = 16;
+    constexpr size_t MAX_TILES = 256;
+    constexpr double MIN_SPAN = 4; // 最多放大到能看见几个元素
+
+    const float NaN = std::numeric_limits<float>::quiet_NaN();
+
+    // 近似viridis的配色
+    const std::vector<QRgb>& colorMap()
+    {
+        static const std::vector<QRgb> lut = []{
+            const QColor keys[] = {{68, 1, 84}, {59, 82, 139}, {33, 145, 140}, {94, 201, 98}, {253, 231, 37}};
+            constexpr int n = sizeof(keys) / sizeof(keys[0]);
+            std::vector<QRgb> res(256);
+            for(int i=0; i<256; i++)
+            {
+                auto t = i / 255.0 * (n - 1);
+                auto k = std::min((int)t, n - 2);
+                auto f = t - k;
+                auto mix = [f](int a, int b){ return (int)std::lround(a + (b - a) * f); };
+                res[i] = qRgb(mix(keys[k].red(), keys[k+1].red()), mix(keys[k].green(), keys[k+1].green()), mix(keys[k].blue(), keys[k+1].blue()));
+            }
+            return res;
+        }();
+        return lut;
+    }
+
+    class TileTask : public QRunnable
+    {
+    public:
+        explicit TileTask(std::function<void()> run)
+        : _run(std::move(run))
+        {
+        }
+
+        void run() override
+        {
+            _run();
+        }
+
+    private:
+        std::function<void()> _run;
+    };
+}
+
+PlotView::PlotView(QWidget* parent)
+: QWidget(parent)
+{
+    _pool.setMaxThreadCount(2);
+    setMinimumSize(64, 64);
+    connect(this, &PlotView::tileLoaded, this, &PlotView::onTileLoaded, Qt::QueuedConnection);
+}
+
+PlotView::~PlotView()
+{
+    _generation++;
+    _pool.clear();
+    _pool.waitForDone();
+}
+
+void PlotView::clear()
+{
+    setPage(nullptr, 0, {});
+}
+
+void PlotView::setPage(std::shared_ptr<Pager> pager, size_t page, StatsKernel kernel)
+{
+    _generation++;
+    _pool.clear();
+    _tiles.clear();
+    _lru.clear();
+    _pending.clear();
+    _range.reset();
+    _source = Source{};
+    if(pager && kernel)
+    {
+        _source.rows = pager->rowCount();
+        _source.cols = pager->columnCount();
+        _source.pager = std::move(pager);
+        _source.page = page;
+        _source.kernel = kernel;
+    }
+    resetView();
+    update();
+}
+
+bool PlotView::isLine(const Source& source)
+{
+    return source.rows == 1 || source.cols == 1;
+}
+
+size_t PlotView::tileEntries(const Source& source, bool rows)
+{
+    if(!isLine(source)) return TILE_2D;
+    auto along = rows ? source.rows : source.cols;
+    return along == 1 ? 1 : TILE_1D;
+}
+
+bool PlotView::isLine() const
+{
+    return isLine(_source);
+}
+
+size_t PlotView::lineLength() const
+{
+    return std::max(_source.rows, _source.cols);
+}
+
+int PlotView::topLevel() const
+{
+    // 整页放进一块的级别
+    auto extent = std::max(_source.rows, _source.cols);
+    auto entries = isLine() ? TILE_1D : TILE_2D;
+    int level = 0;
+    while((entries << level) < extent) level++;
+    return level;
+}
+
+int PlotView::levelFor(double elementsPerPixel) const
+{
+    int level = elementsPerPixel <= 1 ? 0 : (int)std::floor(std::log2(elementsPerPixel));
+    return std::min(level, topLevel());
+}
+
+std::shared_ptr<PlotView::Tile> PlotView::loadTile(const Source& source, const TileKey& key)
+{
+    // 每个方向：第一个元素、格子个数、采样步长、采样个数
+    size_t s = size_t(1) << key.level;
+    auto samplesPerEntry = isLine(source) ? SAMPLES_1D : SAMPLES_2D;
+    struct Axis { size_t first, entries, step, samples; };
+    auto axis = [&](size_t extent, size_t idx, size_t tile_entries){
+        Axis a{};
+        a.first = idx * tile_entries * s;
+        if(a.first >= extent) return a;
+        a.entries = std::min(tile_entries, (extent - a.first + s - 1) / s);
+        a.step = std::max<size_t>(1, s / samplesPerEntry);
+        a.samples = (std::min(a.entries * s, extent - a.first) + a.step - 1) / a.step;
+        return a;
+    };
+    auto r = axis(source.rows, key.row, tileEntries(source, true));
+    auto c = axis(source.cols, key.col, tileEntries(source, false));
+
+    auto tile = std::make_shared<Tile>();
+    tile->rows = r.entries;
+    tile->cols = c.entries;
+    tile->lo.assign(r.entries * c.entries, NaN);
+    tile->hi.assign(r.entries * c.entries, NaN);
+    if(r.samples * c.samples == 0) return tile;
+
+    std::vector<uint8_t> raw(r.samples * c.samples * source.kernel.size);
+    source.pager->readBlock(source.page, r.first, c.first, r.samples, c.samples, raw.data(), r.step, c.step);
+    std::vector<double> values(r.samples * c.samples);
+    source.kernel.convert(raw.data(), values.data(), values.size());
+
+    for(size_t i=0; i<r.samples; i++)
+    {
+        auto row = i * r.step / s;
+        for(size_t j=0; j<c.samples; j++)
+        {
+            auto v = (float)values[i * c.samples + j];
+            if(v != v) continue;
+            auto idx = row * c.entries + j * c.step / s;
+            auto& lo = tile->lo[idx];
+            auto& hi = tile->hi[idx];
+            if(lo != lo || v < lo) lo = v;
+            if(hi != hi || v > hi) hi = v;
+        }
+    }
+    return tile;
+}
+
+std::shared_ptr<const PlotView::Tile> PlotView::findTile(const TileKey& key)
+{
+    auto itr = _tiles.find(key);
+    if(itr == _tiles.end()) return nullptr;
+    _lru.splice(_lru.begin(), _lru, itr->second.lru);
+    return itr->second.tile;
+}
+
+void PlotView::requestTile(const TileKey& key)
+{
+    if(!_source.pager || _tiles.count(key) || !_pending.insert(key).second) return;
+    auto generation = _generation.load();
+    _pool.start(new TileTask([this, source = _source, key, generation]{
+        if(_generation != generation) return;
+        std::shared_ptr<Tile> tile;
+        try {
+            tile = loadTile(source, key);
+        }
+        catch(const std::exception&) {
+            tile = std::make_shared<Tile>(); // 读不出来的块不再重试
+        }
+        {
+            std::lock_guard<std::mutex> lock(_arrived_mutex);
+            _arrived.emplace_back(generation, key, std::move(tile));
+        }
+        emit tileLoaded();
+    }));
+}
+
+void PlotView::onTileLoaded()
+{
+    std::vector<std::tuple<quint64, TileKey, std::shared_ptr<Tile>>> arrived;
+    {
+        std::lock_guard<std::mutex> lock(_arrived_mutex);
+        arrived.swap(_arrived);
+    }
+    auto top = topLevel();
+    for(auto& [generation, key, tile] : arrived)
+    {
+        if(generation != _generation) continue;
+        _pending.erase(key);
+        if(key.level == top && !_range)
+        {
+            // 最粗一级只有一块，它的范围就是整页的范围
+            double lo = INFINITY, hi = -INFINITY;
+            for(auto v : tile->lo) if(v == v) lo = std::min<double>(lo, v);
+            for(auto v : tile->hi) if(v == v) hi = std::max<double>(hi, v);
+            if(lo > hi) lo = hi = 0;
+            _range.emplace(lo, hi);
+            for(auto& cached : _tiles) buildImage(*cached.second.tile);
+        }
+        buildImage(*tile);
+        _lru.push_front(key);
+        _tiles[key] = CachedTile{tile, _lru.begin()};
+    }
+
+    // 最粗一级的块一直留着
+    while(_tiles.size() > MAX_TILES)
+    {
+        auto key = _lru.back();
+        _lru.pop_back();
+        if(key.level == top)
+        {
+            _lru.push_front(key);
+            _tiles[key].lru = _lru.begin();
+            continue;
+        }
+        _tiles.erase(key);
+    }
+    update();
+}
+
+void PlotView::buildImage(Tile& tile) const
+{
+    if(isLine() || !_range || tile.rows * tile.cols == 0) return;
+    auto [lo, hi] = *_range;
+    auto scale = hi > lo ? 255.0 / (hi - lo) : 0.0;
+    auto& lut = colorMap();
+    // 一个格子画成一个像素，格子里的最大值决定颜色，细小的峰值缩小后也看得见
+    tile.image = QImage((int)tile.cols, (int)tile.rows, QImage::Format_ARGB32);
+    for(size_t i=0; i<tile.rows; i++)
+    {
+        auto line = (QRgb*)tile.image.scanLine((int)i);
+        for(size_t j=0; j<tile.cols; j++)
+        {
+            auto v = tile.hi[i * tile.cols + j];
+            line[j] = v == v ? lut[std::clamp((int)((v - lo) * scale), 0, 255)] : qRgba(0, 0, 0, 0);
+        }
+    }
+}
+
+void PlotView::resetView()
+{
+    _x0 = _y0 = 0;
+    if(isLine())
+    {
+        _w = std::max<double>((double)lineLength(), 1);
+        _h = 1;
+    }
+    else
+    {
+        _w = std::max<double>((double)_source.cols, 1);
+        _h = std::max<double>((double)_source.rows, 1);
+    }
+}
+
+QPointF PlotView::toPage(const QPointF& pos) const
+{
+    return QPointF(_x0 + pos.x() * _w / std::max(width(), 1), _y0 + pos.y() * _h / std::max(height(), 1));
+}
+
+void PlotView::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+    if(!_source.pager) return;
+    if(!_range)
+    {
+        requestTile({topLevel(), 0, 0});
+        painter.drawText(rect(), Qt::AlignCenter, tr("Loading..."));
+        return;
+    }
+    if(isLine())
+    {
+        paintLine(painter);
+    }
+    else
+    {
+        paintHeatmap(painter);
+    }
+    painter.setPen(palette().text().color());
+    painter.drawText(rect().adjusted(4, 4, -4, -4), Qt::AlignLeft | Qt::AlignTop,
+        QString("%1 .. %2").arg(_range->first, 0, 'g', 6).arg(_range->second, 0, 'g', 6));
+}
+
+void PlotView::paintHeatmap(QPainter& painter)
+{
+    auto W = std::max(width(), 1);
+    auto H = std::max(height(), 1);
+    auto level = levelFor(std::max(_w / W, _h / H));
+    auto sx = W / _w;
+    auto sy = H / _h;
+    painter.setClipRect(QRectF(-_x0 * sx, -_y0 * sy, _source.cols * sx, _source.rows * sy));
+
+    // 从粗到细画，当前级别还没读到的块先露出下面粗一级的块
+    for(int lev=topLevel(); lev>=level; lev--)
+    {
+        auto span = (double)(TILE_2D << lev);
+        auto tr0 = (size_t)std::max(0.0, std::floor(_y0 / span));
+        auto tc0 = (size_t)std::max(0.0, std::floor(_x0 / span));
+        auto tr1 = (size_t)std::ceil(std::min<double>(_y0 + _h, (double)_source.rows) / span);
+        auto tc1 = (size_t)std::ceil(std::min<double>(_x0 + _w, (double)_source.cols) / span);
+        for(auto tr=tr0; tr<tr1; tr++)
+        {
+            for(auto tc=tc0; tc<tc1; tc++)
+            {
+                TileKey key{lev, tr, tc};
+                auto tile = findTile(key);
+                if(!tile && lev == level) requestTile(key);
+                if(!tile || tile->image.isNull()) continue;
+                auto s = (double)(size_t(1) << lev);
+                QRectF target((tc * span - _x0) * sx, (tr * span - _y0) * sy, tile->cols * s * sx, tile->rows * s * sy);
+                painter.drawImage(target, tile->image);
+            }
+        }
+    }
+    painter.setClipping(false);
+}
+
+void PlotView::paintLine(QPainter& painter)
+{
+    auto W = std::max(width(), 1);
+    auto H = std::max(height(), 1);
+    auto n = lineLength();
+    auto level = levelFor(_w / W);
+    bool along_rows = _source.cols == 1 && _source.rows > 1;
+    auto lo = _range->first;
+    auto hi = _range->second;
+    if(hi <= lo)
+    {
+        lo -= 1;
+        hi += 1;
+    }
+    auto margin = (hi - lo) * 0.05;
+    lo -= margin;
+    hi += margin;
+    auto toY = [&](double v){ return H - (v - lo) / (hi - lo) * H; };
+
+    // 第level级第e个格子的范围，块还没读到时用更粗一级的格子
+    auto entry = [&](int lev, size_t e, float& vlo, float& vhi){
+        for(auto l=lev; l<=topLevel(); l++, e>>=1)
+        {
+            auto t = e / TILE_1D;
+            TileKey key = along_rows ? TileKey{l, t, 0} : TileKey{l, 0, t};
+            auto tile = findTile(key);
+            if(!tile)
+            {
+                if(l == lev) requestTile(key);
+                continue;
+            }
+            auto idx = e % TILE_1D;
+            if(idx >= tile->lo.size()) return false;
+            vlo = tile->lo[idx];
+            vhi = tile->hi[idx];
+            return vlo == vlo;
+        }
+        return false;
+    };
+
+    painter.setRenderHint(QPainter::Antialiasing, level == 0 && _w < W);
+    painter.setPen(QPen(palette().highlight().color(), 1));
+    QPainterPath path;
+    bool open = false;
+    if(level == 0 && _w < W / 2.0)
+    {
+        // 放大到一个元素占好几个像素时，直接连接每个元素
+        auto first = (size_t)std::max(0.0, std::floor(_x0));
+        auto last = std::min(n, (size_t)std::ceil(_x0 + _w) + 1);
+        for(auto i=first; i<last; i++)
+        {
+            float vlo, vhi;
+            if(!entry(0, i, vlo, vhi))
+            {
+                open = false;
+                continue;
+            }
+            QPointF p((i + 0.5 - _x0) * W / _w, toY(vlo));
+            if(open) path.lineTo(p); else path.moveTo(p);
+            open = true;
+        }
+    }
+    else
+    {
+        // 每列像素画出所覆盖格子的min到max
+        for(int px=0; px<W; px++)
+        {
+            auto a = _x0 + px * _w / W;
+            auto b = _x0 + (px + 1) * _w / W;
+            if(b <= 0 || a >= n) continue;
+            auto ea = (size_t)std::max(0.0, a) >> level;
+            auto eb = (std::min((size_t)std::ceil(b), n) - 1) >> level;
+            float plo = NaN, phi = NaN;
+            for(auto e=ea; e<=eb; e++)
+            {
+                float vlo, vhi;
+                if(!entry(level, e, vlo, vhi)) continue;
+                if(plo != plo || vlo < plo) plo = vlo;
+                if(phi != phi || vhi > phi) phi = vhi;
+            }
+            if(plo != plo)
+            {
+                open = false;
+                continue;
+            }
+            QPointF top(px + 0.5, toY(phi)), bottom(px + 0.5, toY(plo));
+            if(open) path.lineTo(bottom); else path.moveTo(bottom);
+            path.lineTo(top);
+            open = true;
+        }
+    }
+    painter.drawPath(path);
+}
+
+void PlotView::wheelEvent(QWheelEvent* event)
+{
+    if(!_source.pager) return;
+    auto factor = std::pow(0.8, event->angleDelta().y() / 120.0);
+    auto pos = QPointF(event->pos());
+    auto p = toPage(pos);
+    auto fx = pos.x() / std::max(width(), 1);
+    auto fy = pos.y() / std::max(height(), 1);
+    // 以鼠标所在的元素为中心缩放，不超出整页
+    auto clampView = [](double& x0, double& w, double v, double f, double extent, double factor){
+        w = std::clamp(w * factor, std::min(MIN_SPAN, extent), std::max(extent, 1.0));
+        x0 = std::clamp(v - f * w, 0.0, std::max(0.0, extent - w));
+    };
+    if(isLine())
+    {
+        clampView(_x0, _w, p.x(), fx, (double)lineLength(), factor);
+    }
+    else
+    {
+        clampView(_x0, _w, p.x(), fx, (double)_source.cols, factor);
+        clampView(_y0, _h, p.y(), fy, (double)_source.rows, factor);
+    }
+    update();
+    event->accept();
+}
+
+void PlotView::mousePressEvent(QMouseEvent* event)
+{
+    if(event->button() == Qt::LeftButton) _drag = event->pos();
+}
+
+void PlotView::mouseMoveEvent(QMouseEvent* event)
+{
+    if(!_drag || !_source.pager) return;
+    auto d = event->pos() - *_drag;
+    _drag = event->pos();
+    auto extent_x = isLine() ? (double)lineLength() : (double)_source.cols;
+    _x0 = std::clamp(_x0 - d.x() * _w / std::max(width(), 1), 0.0, std::max(0.0, extent_x - _w));
+    if(!isLine())
+    {
+        _y0 = std::clamp(_y0 - d.y() * _h / std::max(height(), 1), 0.0, std::max(0.0, (double)_source.rows - _h));
+    }
+    update();
+}
+
+void PlotView::mouseReleaseEvent(QMouseEvent*)
+{
+    _drag.reset();
+}
+
+void PlotView::mouseDoubleClickEvent(QMouseEvent*)
+{
+    resetView();
+    update();
+}
@@ -0,0 +1,111 @@
+#ifndef PLOTVIEW_H
+#define PLOTVIEW_H
+
+#include <QWidget>
+#include <QImage>
+#include <QThreadPool>
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include "datastats.h"
+
+class Pager;
+
+// 当前页的图形预览：2维的页画成热图，只有一行或一列时画成折线
+// 按缩放级别建立min/max金字塔：第L级每个格子概括2^L个元素（热图是2^L×2^L），格子的min/max由步长更小的hyperslab采样得到
+// 只读取当前级别可见的块，块在后台线程读取，还没读到时先画更粗一级的块；滚轮缩放，拖动平移，双击复原
+class PlotView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PlotView(QWidget* parent = nullptr);
+    ~PlotView();
+
+    void setPage(std::shared_ptr<Pager> pager, size_t page, StatsKernel kernel); // pager为空时清空
+    void clear();
+
+signals:
+    void tileLoaded();
+
+private slots:
+    void onTileLoaded();
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
+
+private:
+    struct TileKey
+    {
+        int level;
+        size_t row; // 块的下标，不是元素的下标
+        size_t col;
+        bool operator<(const TileKey& other) const { return std::tie(level, row, col) < std::tie(other.level, other.row, other.col); }
+    };
+
+    struct Tile
+    {
+        size_t rows{0}; // 格子个数
+        size_t cols{0};
+        std::vector<float> lo; // 全是NaN的格子是NaN
+        std::vector<float> hi;
+        QImage image; // 热图，按_range上色
+    };
+
+    // 后台读取时用的一份拷贝，换页不影响正在读的块
+    struct Source
+    {
+        std::shared_ptr<Pager> pager;
+        size_t page{0};
+        StatsKernel kernel;
+        size_t rows{0};
+        size_t cols{0};
+    };
+
+    struct CachedTile
+    {
+        std::shared_ptr<Tile> tile;
+        std::list<TileKey>::iterator lru;
+    };
+
+    static bool isLine(const Source& source);
+    static size_t tileEntries(const Source& source, bool rows); // 一块每个方向的格子个数
+    bool isLine() const;
+    size_t lineLength() const;
+    int topLevel() const;
+    int levelFor(double elementsPerPixel) const;
+    std::shared_ptr<const Tile> findTile(const TileKey& key);
+    static std::shared_ptr<Tile> loadTile(const Source& source, const TileKey& key); // 后台线程调用
+    void requestTile(const TileKey& key);
+    void buildImage(Tile& tile) const;
+    void resetView();
+    QPointF toPage(const QPointF& pos) const;
+    void paintHeatmap(QPainter& painter);
+    void paintLine(QPainter& painter);
+
+    Source _source;
+
+    // 可见范围，按页里的元素下标，x是列，y是行
+    double _x0{0}, _y0{0}, _w{1}, _h{1};
+    std::optional<QPoint> _drag;
+
+    std::map<TileKey, CachedTile> _tiles;
+    std::list<TileKey> _lru; // 最近用过的在前面
+    std::set<TileKey> _pending;
+    std::optional<std::pair<double, double>> _range; // 最粗一级的范围，上色和折线的纵轴用
+
+    QThreadPool _pool;
+    std::atomic<quint64> _generation{0}; // 换页时加一，旧的块读完后丢弃
+    std::mutex _arrived_mutex;
+    std::vector<std::tuple<quint64, TileKey, std::shared_ptr<Tile>>> _arrived;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "prefix.h"
+#include "refresolver.h"
+#include "ioexecutor.h"
+#include "hdf5lock.h"
+
+namespace
+{
+    constexpr size_t REF_CACHE_SIZE = 1 << 20;
+
+    HighFive::ObjectType idType(hid_t id)
+    {
+        switch(H5Iget_type(id))
+        {
+        case H5I_GROUP:
+            return HighFive::ObjectType::Group;
+        case H5I_DATASET:
+            return HighFive::ObjectType::Dataset;
+        case H5I_DATATYPE:
+            return HighFive::ObjectType::UserDataType;
+        default:
+            return HighFive::ObjectType::Other;
+        }
+    }
+}
+
+RefResolver::RefResolver(const HighFive::File& file)
+: _file(file)
+{
+}
+
+RefResolver::~RefResolver()
+{
+    H5Lock lock(hdf5Mutex());
+    _file.reset();
+}
+
+std::optional<RefResolver::RefInfo> RefResolver::find(hobj_ref_t ref) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto itr = _cache.find(ref);
+    if(itr == _cache.end()) return std::nullopt;
+    return itr->second;
+}
+
+void RefResolver::store(hobj_ref_t ref, const RefInfo& info)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_cache.size() >= REF_CACHE_SIZE) _cache.clear();
+    _cache[ref] = info;
+}
+
+RefResolver::RefInfo RefResolver::dereference(hobj_ref_t ref) const
+{
+    RefInfo info;
+    hid_t id = H5Rdereference(_file->getId(), H5P_DEFAULT, H5R_OBJECT, &ref);
+    if(id < 0) return info;
+    auto len = H5Iget_name(id, nullptr, 0);
+    if(len > 0)
+    {
+        info.path.resize(len + 1);
+        H5Iget_name(id, info.path.data(), len + 1);
+        info.path.resize(len);
+    }
+    info.type = idType(id);
+    if(info.type != HighFive::ObjectType::Dataset) // 组等只显示路径
+    {
+        info.preview = QString::fromStdString(info.path);
+        info.has_preview = true;
+    }
+    H5Oclose(id);
+    return info;
+}
+
+RefResolver::RefInfo RefResolver::resolve(hobj_ref_t ref)
+{
+    if(auto info = find(ref)) return *info;
+    H5Lock lock(hdf5Mutex());
+    auto info = dereference(ref);
+    store(ref, info);
+    return info;
+}
+
+void RefResolver::resolvePaths(const std::vector<hobj_ref_t>& refs)
+{
+    H5Lock lock(hdf5Mutex());
+    for(auto ref : refs)
+    {
+        if(find(ref)) continue;
+        store(ref, dereference(ref));
+    }
+}
+
+void RefResolver::resolvePreviews(const std::vector<hobj_ref_t>& refs, const Preview& preview, const IoTask* task)
+{
+    for(auto ref : refs)
+    {
+        if(task && task->isCancelled()) return;
+        auto info = resolve(ref);
+        if(info.has_preview || info.path.empty()) continue;
+
+        // 每个预览单独拿锁，界面线程不用等整批做完
+        H5Lock lock(hdf5Mutex());
+        try {
+            info.preview = preview(_file->getDataSet(info.path));
+        }
+        catch(const HighFive::Exception&) {
+            info.preview = QString::fromStdString(info.path);
+        }
+        info.has_preview = true;
+        store(ref, info);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef REFRESOLVER_H
+#define REFRESOLVER_H
+
+#include <mutex>
+#include <unordered_map>
+
+class IoTask;
+
+// MATLAB的cell/struct数组里存的是对象引用，解析结果按引用（对象地址）缓存，同一个文件里只解析一次
+// 先批量解析路径和类型，预览（getShortString）比较慢，之后再批量补上
+class RefResolver
+{
+public:
+    struct RefInfo
+    {
+        std::string path; // 为空表示解析失败
+        HighFive::ObjectType type{HighFive::ObjectType::Other};
+        QString preview;
+        bool has_preview{false};
+    };
+    using Preview = std::function<QString(const HighFive::DataSet&)>;
+
+    explicit RefResolver(const HighFive::File& file);
+    ~RefResolver();
+
+    RefInfo resolve(hobj_ref_t ref); // 没缓存时马上解析路径和类型
+    std::optional<RefInfo> find(hobj_ref_t ref) const; // 只查缓存，不用拿HDF5的锁
+    void resolvePaths(const std::vector<hobj_ref_t>& refs);
+    void resolvePreviews(const std::vector<hobj_ref_t>& refs, const Preview& preview, const IoTask* task = nullptr);
+
+private:
+    RefInfo dereference(hobj_ref_t ref) const;
+    void store(hobj_ref_t ref, const RefInfo& info);
+
+    std::optional<HighFive::File> _file;
+    mutable std::mutex _mutex; // 只保护_cache，拿HDF5锁之后才能拿这个锁
+    std::unordered_map<hobj_ref_t, RefInfo> _cache;
+};
+
+#endif
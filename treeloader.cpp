@@ -0,0 +1,310 @@
+#include "prefix.h"
+#include "treeloader.h"
+#include "hdf5lock.h"
+#include "helper.h"
+#include "metaindex.h"
+#include "matfile.h"
+#include <QScrollBar>
+
+namespace
+{
+    constexpr int BATCH_SIZE = 256;
+    constexpr int PATH_ROLE = Qt::UserRole;
+
+    constexpr int TYPE_PENDING_ROLE = Qt::UserRole + 1; // 数据集类型还没读
+    constexpr int TYPE_FILL_DELAY_MS = 50;
+
+    struct IterData
+    {
+        QVector<TreeEntry>* entries;
+    };
+
+    // 只取对象类型，不打开数据集；数据集的元素类型等显示到界面上时再读
+    herr_t iterLink(hid_t loc, const char* name, const H5L_info_t*, void* op_data)
+    {
+        auto data = static_cast<IterData*>(op_data);
+        TreeEntry entry;
+        entry.name = QString::fromStdString(name);
+        H5O_info_t info;
+        if(H5Oget_info_by_name(loc, name, &info, H5O_INFO_BASIC, H5P_DEFAULT) >= 0)
+        {
+            entry.type = toObjectType(info.type);
+        }
+        entry.type_str = typeToStr(entry.type);
+        data->entries->append(entry);
+        return data->entries->size() >= BATCH_SIZE ? 1 : 0; // 返回正数让H5Literate停下，下一批从idx继续
+    }
+
+    class GroupEnumTask : public QRunnable
+    {
+    public:
+        GroupEnumTask(TreeLoader* loader, const HighFive::File& file, std::string path, quint64 request, std::shared_ptr<std::atomic<bool>> cancelled)
+        : _loader(loader), _file(file), _path(std::move(path)), _request(request), _cancelled(std::move(cancelled))
+        {
+        }
+
+        ~GroupEnumTask()
+        {
+            H5Lock lock(hdf5Mutex());
+            _file.reset();
+        }
+
+        void run() override
+        {
+            std::optional<HighFive::Group> group;
+            try {
+                H5Lock lock(hdf5Mutex());
+                group.emplace(_file->getGroup(_path.empty() ? "/" : _path));
+            }
+            catch(const HighFive::Exception&) {
+                emit _loader->batchReady(_request, {}, true);
+                return;
+            }
+
+            hsize_t idx = 0;
+            bool finished = false;
+            while(!finished && !*_cancelled)
+            {
+                QVector<TreeEntry> entries;
+                {
+                    H5Lock lock(hdf5Mutex());
+                    IterData data{&entries};
+                    auto ret = H5Literate(group->getId(), H5_INDEX_NAME, H5_ITER_INC, &idx, iterLink, &data);
+                    finished = ret <= 0; // 0: 遍历完了, 负数: 出错
+                }
+                emit _loader->batchReady(_request, entries, finished);
+            }
+
+            H5Lock lock(hdf5Mutex());
+            group.reset();
+        }
+
+    private:
+        TreeLoader* _loader;
+        std::optional<HighFive::File> _file;
+        std::string _path;
+        quint64 _request;
+        std::shared_ptr<std::atomic<bool>> _cancelled;
+    };
+
+    // 读一组可见数据集的类型，每个数据集单独加锁，不会长时间占着HDF5
+    class DatasetTypeTask : public QRunnable
+    {
+    public:
+        DatasetTypeTask(TreeLoader* loader, const HighFive::File& file, QStringList paths, quint64 generation, std::shared_ptr<std::atomic<bool>> cancelled)
+        : _loader(loader), _file(file), _paths(std::move(paths)), _generation(generation), _cancelled(std::move(cancelled))
+        {
+        }
+
+        ~DatasetTypeTask()
+        {
+            H5Lock lock(hdf5Mutex());
+            _file.reset();
+        }
+
+        void run() override
+        {
+            QStringList types;
+            for(const auto& path : _paths)
+            {
+                if(*_cancelled) return;
+                QString type_str;
+                try {
+                    H5Lock lock(hdf5Mutex());
+                    type_str = datasetTypeStr(_file->getDataSet(path.toStdString()));
+                }
+                catch(const HighFive::Exception&) {
+                }
+                types.append(type_str);
+            }
+            emit _loader->typesReady(_generation, _paths, types);
+        }
+
+    private:
+        TreeLoader* _loader;
+        std::optional<HighFive::File> _file;
+        QStringList _paths;
+        quint64 _generation;
+        std::shared_ptr<std::atomic<bool>> _cancelled;
+    };
+}
+
+TreeLoader::TreeLoader(QTreeWidget* tree, QObject *parent)
+: QObject(parent), _tree(tree), _cancelled(std::make_shared<std::atomic<bool>>(false))
+{
+    qRegisterMetaType<QVector<TreeEntry>>("QVector<TreeEntry>");
+    connect(this, &TreeLoader::batchReady, this, &TreeLoader::onBatchReady, Qt::QueuedConnection);
+    connect(this, &TreeLoader::typesReady, this, &TreeLoader::onTypesReady, Qt::QueuedConnection);
+    connect(_tree, &QTreeWidget::itemExpanded, this, &TreeLoader::fetchChildren);
+
+    // 滚动、展开、折叠以后可见的节点变了，稍等一下再补读它们的类型
+    _type_timer.setSingleShot(true);
+    _type_timer.setInterval(TYPE_FILL_DELAY_MS);
+    connect(&_type_timer, &QTimer::timeout, this, &TreeLoader::fillVisibleTypes);
+    auto schedule = [this]{ _type_timer.start(); };
+    connect(_tree->verticalScrollBar(), &QScrollBar::valueChanged, this, schedule);
+    connect(_tree, &QTreeWidget::itemExpanded, this, schedule);
+    connect(_tree, &QTreeWidget::itemCollapsed, this, schedule);
+}
+
+TreeLoader::~TreeLoader()
+{
+    cancel();
+    _pool.waitForDone();
+    H5Lock lock(hdf5Mutex());
+    _file.reset();
+}
+
+void TreeLoader::cancel()
+{
+    *_cancelled = true;
+    _cancelled = std::make_shared<std::atomic<bool>>(false);
+    _requests.clear();
+    _type_requests.clear();
+    _type_generation++;
+}
+
+void TreeLoader::setIndex(std::shared_ptr<const MetaIndex> index)
+{
+    _index = std::move(index);
+}
+
+void TreeLoader::setRoot(const HighFive::File& file, const std::string& path)
+{
+    cancel();
+    _tree->clear();
+    {
+        H5Lock lock(hdf5Mutex());
+        _file = std::make_unique<HighFive::File>(file);
+    }
+    _root = path;
+    startEnum(nullptr, path);
+}
+
+void TreeLoader::addPlaceholder(QTreeWidgetItem* item)
+{
+    auto placeholder = new QTreeWidgetItem(item, QStringList{tr("Loading...")});
+    placeholder->setFlags(Qt::ItemIsEnabled); // 不能选中，避免当成路径打开
+}
+
+void TreeLoader::fetchChildren(QTreeWidgetItem* item)
+{
+    if(!item || !_file) return;
+    // 只有占位节点的组才需要加载
+    if(item->childCount() != 1 || item->child(0)->data(0, PATH_ROLE).isValid()) return;
+    if(std::find(_requests.begin(), _requests.end(), item) != _requests.end()) return;
+    startEnum(item, item->data(0, PATH_ROLE).toString().toStdString());
+}
+
+void TreeLoader::startEnum(QTreeWidgetItem* parent, const std::string& path)
+{
+    auto request = _next_request++;
+    _requests.insert(request, parent);
+
+    auto node = _index ? _index->find(path) : MetaIndex::NPOS;
+    if(node != MetaIndex::NPOS && _index->childrenIndexed(node))
+    {
+        auto toQString = [](std::string_view s){ return QString::fromUtf8(s.data(), (int)s.size()); };
+        QVector<TreeEntry> entries;
+        entries.reserve((int)_index->childCount(node));
+        auto begin = _index->childBegin(node);
+        for(auto i=begin; i<begin+_index->childCount(node); i++)
+        {
+            entries.append({toQString(_index->name(i)), toQString(_index->typeStr(i)), _index->type(i), toQString(_index->matlabClass(i))});
+        }
+        onBatchReady(request, entries, true);
+        return;
+    }
+
+    H5Lock lock(hdf5Mutex());
+    _pool.start(new GroupEnumTask(this, *_file, path, request, _cancelled));
+}
+
+void TreeLoader::onBatchReady(quint64 request, QVector<TreeEntry> entries, bool finished)
+{
+    auto itr = _requests.find(request);
+    if(itr == _requests.end()) return; // 已经取消了
+    auto parent = itr.value();
+    auto parent_path = parent ? parent->data(0, PATH_ROLE).toString() : QString::fromStdString(_root);
+
+    // MAT文件根下的#refs#只是cell、struct数组元素的存放处，通过引用访问，不在树里显示
+    bool top = parent_path.isEmpty() || parent_path == "/";
+    QList<QTreeWidgetItem*> items;
+    for(const auto& entry : entries)
+    {
+        if(top && isMatInternal(entry.name)) continue;
+        auto type_str = entry.matlab_class.isEmpty() ? entry.type_str : entry.type_str + " [" + entry.matlab_class + "]";
+        auto item = new QTreeWidgetItem(QStringList{entry.name, type_str});
+        item->setData(0, PATH_ROLE, parent_path + "/" + entry.name);
+        if(!entry.matlab_class.isEmpty())
+        {
+            item->setToolTip(0, "MATLAB_class: " + entry.matlab_class);
+        }
+        if(entry.type == HighFive::ObjectType::Group)
+        {
+            item->setIcon(0, QIcon(":/icons/group"));
+            addPlaceholder(item);
+        }
+        else if(entry.type == HighFive::ObjectType::Dataset)
+        {
+            item->setIcon(0, QIcon(":/icons/cells"));
+            if(entry.type_str == typeToStr(entry.type))
+            {
+                item->setData(0, TYPE_PENDING_ROLE, true);
+            }
+        }
+        items.append(item);
+    }
+
+    if(parent)
+    {
+        parent->addChildren(items);
+    }
+    else
+    {
+        _tree->addTopLevelItems(items);
+    }
+    if(!items.empty()) _type_timer.start();
+
+    if(finished)
+    {
+        // 占位节点总是第一个子节点
+        if(parent && parent->childCount() > 0 && !parent->child(0)->data(0, PATH_ROLE).isValid())
+        {
+            delete parent->takeChild(0);
+        }
+        _requests.erase(itr);
+    }
+}
+
+void TreeLoader::fillVisibleTypes()
+{
+    if(!_file) return;
+    QStringList paths;
+    auto height = _tree->viewport()->height();
+    for(auto item = _tree->itemAt(0, 0); item && _tree->visualItemRect(item).top() < height; item = _tree->itemBelow(item))
+    {
+        if(!item->data(0, TYPE_PENDING_ROLE).toBool()) continue;
+        item->setData(0, TYPE_PENDING_ROLE, false);
+        auto path = item->data(0, PATH_ROLE).toString();
+        _type_requests.insert(path, item);
+        paths.append(path);
+    }
+    if(paths.empty()) return;
+
+    H5Lock lock(hdf5Mutex());
+    _pool.start(new DatasetTypeTask(this, *_file, paths, _type_generation, _cancelled));
+}
+
+void TreeLoader::onTypesReady(quint64 generation, QStringList paths, QStringList types)
+{
+    if(generation != _type_generation) return; // 树已经换过了
+    for(int i=0; i<paths.size(); i++)
+    {
+        auto item = _type_requests.take(paths[i]);
+        if(item && !types[i].isEmpty())
+        {
+            item->setText(1, item->text(1) + "(" + types[i] + ")");
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef TREELOADER_H
+#define TREELOADER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QHash>
+#include <QTimer>
+#include <atomic>
+
+class MetaIndex;
+
+struct TreeEntry
+{
+    QString name;
+    QString type_str;
+    HighFive::ObjectType type{HighFive::ObjectType::Other};
+    QString matlab_class;
+};
+Q_DECLARE_METATYPE(TreeEntry)
+
+// 树节点在展开时才加载子节点。组成员在后台线程用H5Literate分批枚举，每批加入树中，界面不用等整个文件遍历完
+class TreeLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TreeLoader(QTreeWidget* tree, QObject *parent = nullptr);
+    ~TreeLoader();
+
+    void setRoot(const HighFive::File& file, const std::string& path); // 清空树，加载path的直接成员
+    void cancel(); // 取消所有未完成的枚举，不再往树里加节点
+    void setIndex(std::shared_ptr<const MetaIndex> index); // 有索引时直接从索引取子节点，不用后台枚举
+
+signals:
+    void batchReady(quint64 request, QVector<TreeEntry> entries, bool finished);
+    void typesReady(quint64 generation, QStringList paths, QStringList types);
+
+private slots:
+    void fetchChildren(QTreeWidgetItem* item);
+    void onBatchReady(quint64 request, QVector<TreeEntry> entries, bool finished);
+    void fillVisibleTypes(); // 只读当前可见的数据集的类型
+    void onTypesReady(quint64 generation, QStringList paths, QStringList types);
+
+private:
+    void startEnum(QTreeWidgetItem* parent, const std::string& path);
+    static void addPlaceholder(QTreeWidgetItem* item);
+
+    QTreeWidget* _tree;
+    QThreadPool _pool;
+    std::unique_ptr<HighFive::File> _file;
+    std::string _root;
+    std::shared_ptr<const MetaIndex> _index;
+    std::shared_ptr<std::atomic<bool>> _cancelled;
+    quint64 _next_request{1};
+    QHash<quint64, QTreeWidgetItem*> _requests; // nullptr表示顶层
+    QTimer _type_timer;
+    quint64 _type_generation{0};
+    QHash<QString, QTreeWidgetItem*> _type_requests;
+};
+
+#endif